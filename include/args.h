@@ -151,6 +151,9 @@ struct GCNOpts : BaseOpts
     unsigned use_distance = false;
     int budget = 0;
     bool projective = false;
+    bool map_decode = false;
+    unsigned mst_window = 500;
+    unsigned mst_overlap = 50;
 
     float dropout = .1f;
     std::string tree_str = "gold";
@@ -225,6 +228,21 @@ struct GCNOpts : BaseOpts
             } else if (arg == "--projective") {
                 projective = true;
                 i += 1;
+            } else if (arg == "--map-decode") {
+                map_decode = true;
+                i += 1;
+            } else if (arg == "--mst-window") {
+                assert(i + 1 < argc);
+                std::string val = argv[i + 1];
+                std::istringstream vals(val);
+                vals >> mst_window;
+                i += 2;
+            } else if (arg == "--mst-overlap") {
+                assert(i + 1 < argc);
+                std::string val = argv[i + 1];
+                std::istringstream vals(val);
+                vals >> mst_overlap;
+                i += 2;
             } else if (arg == "--use-distance") {
                 use_distance = true;
                 i += 1;
@@ -243,6 +261,9 @@ struct GCNOpts : BaseOpts
         o << "        tree: " << tree_str << '\n';
         o << "      budget: " << budget << '\n';
         o << "  projective: " << projective << '\n';
+        o << "  map decode: " << map_decode << '\n';
+        o << "  MST window: " << mst_window << '\n';
+        o << " MST overlap: " << mst_overlap << '\n';
         o << "    use dist: " << use_distance << '\n';
         return o;
     }
@@ -309,7 +330,8 @@ struct AttnOpts : public BaseOpts
         HEAD,
         HEADMATCH,
         HEADHO,
-        HEADMATCHHO
+        HEADMATCHHO,
+        SINKHORN
     };
 
     bool is_sparsemap()
@@ -333,6 +355,30 @@ struct AttnOpts : public BaseOpts
                 assert(i + 1 < argc);
                 attn_str = argv[i + 1];
                 i += 2;
+            } else if (arg == "--attn-topk") {
+                assert(i + 1 < argc);
+                std::string val = argv[i + 1];
+                std::istringstream vals(val);
+                vals >> topk;
+                i += 2;
+            } else if (arg == "--attn-auction") {
+                assert(i + 1 < argc);
+                std::string val = argv[i + 1];
+                std::istringstream vals(val);
+                vals >> auction_eps;
+                i += 2;
+            } else if (arg == "--sinkhorn-iter") {
+                assert(i + 1 < argc);
+                std::string val = argv[i + 1];
+                std::istringstream vals(val);
+                vals >> sinkhorn_iter;
+                i += 2;
+            } else if (arg == "--sinkhorn-temp") {
+                assert(i + 1 < argc);
+                std::string val = argv[i + 1];
+                std::istringstream vals(val);
+                vals >> sinkhorn_temp;
+                i += 2;
             } else {
                 i += 1;
             }
@@ -359,6 +405,8 @@ struct AttnOpts : public BaseOpts
             return Attn::HEADHO;
         else if (attn_str == "headmatch-ho")
             return Attn::HEADMATCHHO;
+        else if (attn_str == "sinkhorn")
+            return Attn::SINKHORN;
         else {
             std::cerr << "Invalid attention type." << std::endl;
             std::exit(EXIT_FAILURE);
@@ -369,17 +417,31 @@ struct AttnOpts : public BaseOpts
     {
         std::ostringstream fn;
         fn << "_attn_" << attn_str;
+        if (topk > 0)
+            fn << "_topk_" << topk;
+        if (auction_eps > 0)
+            fn << "_auction_" << auction_eps;
+        if (attn_str == "sinkhorn")
+            fn << "_iter_" << sinkhorn_iter << "_temp_" << sinkhorn_temp;
         return fn.str();
     }
 
     virtual std::ostream& print(std::ostream& o) const override
     {
         o << " Attention settings\n"
-          << "     Attn type: " << attn_str << '\n';
+          << "     Attn type: " << attn_str << '\n'
+          << "  Match top-k: " << topk << '\n'
+          << "   Auction eps: " << auction_eps << '\n'
+          << "Sinkhorn iters: " << sinkhorn_iter << '\n'
+          << " Sinkhorn temp: " << sinkhorn_temp << '\n';
         return o;
     }
 
     std::string attn_str = "softmax";
+    unsigned topk = 0;
+    double auction_eps = 0;
+    unsigned sinkhorn_iter = 10;
+    float sinkhorn_temp = 1;
 };
 
 
@@ -566,6 +628,13 @@ struct MultiLabelOpts : public BaseOpts
     std::string dataset = "bibtex";
     std::string method = "simple";
 
+    /* structured methods: correlate labels only along a Chow-Liu tree */
+    bool label_tree = false;
+
+    /* structured methods: if nonzero, rank of the label correlations;
+     * only along the label tree */
+    unsigned corr_rank = 0;
+
     virtual void parse(int argc, char** argv)
     {
         int i = 1;
@@ -579,6 +648,15 @@ struct MultiLabelOpts : public BaseOpts
                 assert(i + 1 < argc);
                 method = argv[i + 1];
                 i += 2;
+            } else if (arg == "--label-tree") {
+                label_tree = true;
+                i += 1;
+            } else if (arg == "--corr-rank") {
+                assert(i + 1 < argc);
+                std::string val = argv[i + 1];
+                std::istringstream vals(val);
+                vals >> corr_rank;
+                i += 2;
             } else {
                 i += 1;
             }
@@ -589,7 +667,9 @@ struct MultiLabelOpts : public BaseOpts
     {
         o << " MultiLabel settings\n"
           << " dataset: " << dataset << '\n'
-          << " : " << method << '\n';
+          << " : " << method << '\n'
+          << " label tree: " << label_tree << '\n'
+          << " corr. rank: " << corr_rank << '\n';
         return o;
     }
 
@@ -597,6 +677,10 @@ struct MultiLabelOpts : public BaseOpts
     {
         std::ostringstream fn;
         fn << "_" << dataset << "_" << method << "_";
+        if (label_tree)
+            fn << "tree_";
+        if (corr_rank > 0)
+            fn << "rank_" << corr_rank << "_";
         return fn.str();
     }
 };
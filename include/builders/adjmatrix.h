@@ -2,6 +2,9 @@
 
 /* build an adj matrix using different strategies */
 
+#include <functional>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include <dynet/expr.h>
@@ -12,6 +15,10 @@
 #include "builders/arcscorers.h"
 #include "builders/bilstm.h"
 #include "builders/distance-bias.h"
+#include "builders/gcn.h"
+#include "factors/BatchDependencyDecoder.h"
+#include "factors/FactorArena.h"
+#include "factors/TreeFactor.h"
 #include "sparsemap.h"
 
 namespace dy = dynet;
@@ -22,6 +29,12 @@ struct TreeAdjacency
     virtual dy::Expression make_adj(const std::vector<dy::Expression>& input,
                                     const Sentence& sent) = 0;
 
+    /* GCN graphs for a whole batch; by default the adjacency matrices,
+     * one at a time. */
+    virtual std::vector<GCNGraph> make_adj_batch(
+      const std::vector<std::vector<dy::Expression>>& inputs,
+      const std::vector<const Sentence*>& sents);
+
     /* This is so that we can jointly learn two trees with cross-constraints */
     virtual std::tuple<dy::Expression, dy::Expression> make_adj_pair(
       const std::vector<dy::Expression>& enc_prem,
@@ -33,31 +46,44 @@ struct TreeAdjacency
     virtual void clear_print() {};
 };
 
+/* Trees that do not depend on the input. The batch is handed to the GCN
+ * as head arrays, so it never builds the adjacency matrices. */
 struct FixedAdjacency : TreeAdjacency
 {
     dy::ComputationGraph* cg_;
     virtual void new_graph(dy::ComputationGraph& cg, bool training) override;
     virtual dy::Expression make_fixed_adj(const std::vector<unsigned>& heads);
+
+    /* the head of every token, 0 the root */
+    virtual std::vector<unsigned> heads(const Sentence& sent) = 0;
+
+    virtual dy::Expression make_adj(const std::vector<dy::Expression>&,
+                                    const Sentence& sent) override;
+
+    virtual std::vector<GCNGraph> make_adj_batch(
+      const std::vector<std::vector<dy::Expression>>& inputs,
+      const std::vector<const Sentence*>& sents) override;
 };
 
 struct FlatAdjacency : FixedAdjacency
 {
-    virtual dy::Expression make_adj(const std::vector<dy::Expression>&,
-                                    const Sentence& sent) override;
+    virtual std::vector<unsigned> heads(const Sentence& sent) override;
 };
 
 struct LtrAdjacency : FixedAdjacency
 {
-    virtual dy::Expression make_adj(const std::vector<dy::Expression>&,
-                                    const Sentence& sent) override;
+    virtual std::vector<unsigned> heads(const Sentence& sent) override;
 };
 
 struct CustomAdjacency : FixedAdjacency
 {
-    virtual dy::Expression make_adj(const std::vector<dy::Expression>&,
-                                    const Sentence& sent) override;
+    virtual std::vector<unsigned> heads(const Sentence& sent) override;
 };
 
+/* Sentences of more than `window` tokens are split into windows of at
+ * most `window` tokens, neighbours sharing `overlap` of them. Each window
+ * gets its own tree under the root, and every token keeps the head from
+ * the window whose core (the overlaps split in the middle) holds it. */
 struct MSTAdjacency : TreeAdjacency
 {
     explicit MSTAdjacency(dy::ParameterCollection& params,
@@ -65,12 +91,45 @@ struct MSTAdjacency : TreeAdjacency
                           unsigned hidden_dim,
                           bool use_distance=true,
                           int budget=0,
-                          bool projective=false);
+                          bool projective=false,
+                          bool map_decode=false,
+                          unsigned window=500,
+                          unsigned overlap=50);
 
     virtual dy::Expression make_adj(const std::vector<dy::Expression>&,
                                     const Sentence& sent) override;
+
+    /* The SparseMAP tree distribution, as the few trees of its support
+     * and their weights, which the GCN aggregates sparsely. Falls back to
+     * the dense marginals of make_adj when the graph is more than one
+     * tree factor. */
+    GCNGraph make_graph(const std::vector<dy::Expression>& enc,
+                        const Sentence& sent);
+
+    /* With map_decode, test-time trees are MAP trees decoded for the whole
+     * batch at once by BatchDependencyDecoder, and passed on as heads. */
+    virtual std::vector<GCNGraph> make_adj_batch(
+      const std::vector<std::vector<dy::Expression>>& inputs,
+      const std::vector<const Sentence*>& sents) override;
+
     virtual void new_graph(dy::ComputationGraph& cg, bool training) override;
 
+    /* contextual features the arc scorer sees */
+    virtual std::vector<dy::Expression> encode(
+      const std::vector<dy::Expression>& enc)
+    {
+        return enc;
+    }
+
+    dy::Expression arc_scores(const std::vector<dy::Expression>& enc);
+
+    /* tree factor (and budget constraints) over sz nodes, root included;
+     * the tree factor lives in the arena, reset by new_graph. */
+    std::unique_ptr<AD3::FactorGraph> make_tree_graph(unsigned sz);
+
+    /* arcs and index tables for sz nodes, built on first use */
+    std::shared_ptr<const AD3::TreeSkeleton> skeleton(unsigned sz);
+
     virtual void set_print(const std::string& fn) override {
         opts.log_stream = std::make_shared<std::ofstream>(fn);
     }
@@ -85,6 +144,22 @@ struct MSTAdjacency : TreeAdjacency
     DistanceBiasBuilder distance_bias;
     int budget;
     bool projective;
+    bool map_decode;
+    unsigned window;
+    unsigned overlap;
+    bool training_ = false;
+    BatchDependencyDecoder decoder;
+    std::unordered_map<unsigned, std::shared_ptr<const AD3::TreeSkeleton>>
+      skeletons_;
+    sparsemap::FactorArena arena_;
+
+    /* declares the tree factor over a skeleton's variables; the decoder
+     * instantiation is picked once, by the constructor */
+    std::function<void(sparsemap::FactorArena&,
+                       AD3::FactorGraph*,
+                       const std::vector<AD3::BinaryVariable*>&,
+                       std::shared_ptr<const AD3::TreeSkeleton>)>
+      declare_tree_;
 };
 
 
@@ -96,10 +171,13 @@ struct MSTLSTMAdjacency : MSTAdjacency
                               unsigned hidden_dim,
                               float dropout_p=.0f,
                               int budget=0,
-                              bool projective=false);
+                              bool projective=false,
+                              bool map_decode=false,
+                              unsigned window=500,
+                              unsigned overlap=50);
 
-    virtual dy::Expression make_adj(const std::vector<dy::Expression>&,
-                                    const Sentence& sent) override;
+    virtual std::vector<dy::Expression> encode(
+      const std::vector<dy::Expression>& enc) override;
     virtual void new_graph(dy::ComputationGraph& cg, bool training) override;
 
     BiLSTMSettings bilstm_settings;
@@ -8,15 +8,42 @@
 #include <dynet/model.h>
 
 #include "data.h"
+#include "factors/FactorArena.h"
 #include "sparsemap.h"
 
+namespace sparsemap {
+class FactorMatching;
+}
+
+/* how matching-based builders solve their matching factors */
+struct MatchOpts
+{
+    /* if nonzero, only the top-k hypothesis words of every premise word
+     * may be matched, and the matching is solved sparsely. */
+    unsigned topk = 0;
+
+    /* if positive, dense matchings are solved by auction to within
+     * n * auction_eps of the best one, instead of exactly by LAPJV. */
+    double auction_eps = 0;
+
+    /* Sinkhorn attention: number of iterations and temperature */
+    unsigned sinkhorn_iter = 10;
+    float sinkhorn_temp = 1;
+};
+
 struct BiAttentionBuilder
 {
+    /* resets the factor arena: overrides must call it */
     virtual void new_graph(dynet::ComputationGraph& cg, bool training);
     virtual std::tuple<dynet::Expression, dynet::Expression> apply(
       const dynet::Expression scores,
       const NLIPair& sample) = 0;
 
+    /* attention for every pair of a batch; by default, apply each. */
+    virtual std::vector<std::tuple<dynet::Expression, dynet::Expression>>
+    apply_batch(const std::vector<dynet::Expression>& scores,
+                const NLIBatch& batch);
+
     virtual void set_print(const std::string& fn) {
         out = std::make_shared<std::ofstream>(fn);
     }
@@ -26,6 +53,10 @@ struct BiAttentionBuilder
     }
 
     std::shared_ptr<std::ostream> out;
+
+  protected:
+    /* factors of the structured attention graphs of the current batch */
+    sparsemap::FactorArena arena;
 };
 
 struct BiSoftmaxBuilder : BiAttentionBuilder
@@ -51,6 +82,35 @@ struct SymmBiAttnBuilder : BiAttentionBuilder
     virtual std::tuple<dynet::Expression, dynet::Expression> apply(
       const dynet::Expression scores,
       const NLIPair& sample);
+
+    /* As apply, then solve the first MAP of all dense matching factors of
+     * the batch in one parallel lapjv_batch call, before the forward pass
+     * runs SparseMAP on each. */
+    virtual std::vector<std::tuple<dynet::Expression, dynet::Expression>>
+    apply_batch(const std::vector<dynet::Expression>& scores,
+                const NLIBatch& batch);
+
+  protected:
+    /* called by attend for a dense matching factor with potentials eta;
+     * kept only while in apply_batch. */
+    void defer_map(sparsemap::FactorMatching* matching,
+                   const dynet::Expression& eta);
+
+    bool batching = false;
+    std::vector<std::pair<sparsemap::FactorMatching*, dynet::Expression>>
+      deferred;
+};
+
+/* dense doubly-stochastic attention by entropic matching */
+struct SinkhornBuilder : SymmBiAttnBuilder
+{
+    MatchOpts match_opts;
+
+    explicit SinkhornBuilder(const MatchOpts& match_opts = {});
+
+    virtual dynet::Expression attend(const dynet::Expression scores,
+                                     const std::vector<int>& prem_heads,
+                                     const std::vector<int>& hypo_heads);
 };
 
 struct IndepBiAttnBuilder : BiAttentionBuilder
@@ -67,8 +127,10 @@ struct IndepBiAttnBuilder : BiAttentionBuilder
 struct MatchingBuilder : SymmBiAttnBuilder
 {
     dynet::SparseMAPOpts opts;
+    MatchOpts match_opts;
 
-    explicit MatchingBuilder(const dynet::SparseMAPOpts& opts);
+    explicit MatchingBuilder(const dynet::SparseMAPOpts& opts,
+                             const MatchOpts& match_opts = {});
 
     virtual void new_graph(dynet::ComputationGraph& cg, bool training);
 
@@ -136,9 +198,11 @@ struct HeadPreservingMatchingBuilder : SymmBiAttnBuilder
     dynet::Parameter p_affinity;
     dynet::Expression e_affinity;
     dynet::SparseMAPOpts opts;
+    MatchOpts match_opts;
 
     explicit HeadPreservingMatchingBuilder(dynet::ParameterCollection& params,
-                                           const dynet::SparseMAPOpts& opts);
+                                           const dynet::SparseMAPOpts& opts,
+                                           const MatchOpts& match_opts = {});
 
     virtual void new_graph(dynet::ComputationGraph& cg, bool training);
 
@@ -169,7 +233,8 @@ struct HeadHOMatchingBuilder : HeadPreservingMatchingBuilder
     dynet::Expression e_cross, e_grandpa;
 
     explicit HeadHOMatchingBuilder(dynet::ParameterCollection& params,
-                                   const dynet::SparseMAPOpts& opts);
+                                   const dynet::SparseMAPOpts& opts,
+                                   const MatchOpts& match_opts = {});
 
     virtual void new_graph(dynet::ComputationGraph& cg, bool training);
     virtual dynet::Expression attend(const dynet::Expression scores,
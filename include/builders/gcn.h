@@ -5,6 +5,7 @@
  * Part of https://github.com/FilippoC/dynet-tools/
  */
 
+#include <utility>
 #include <vector>
 
 #include <dynet/model.h>
@@ -12,6 +13,36 @@
 
 namespace dy = dynet;
 
+/* What a GCN propagates over: trees, kept as the head of every node
+ * (heads[m - 1] for node m, 0 the root) and aggregated sparsely, or else
+ * a dense (1 + n) x (1 + n) adjacency. A single fixed tree needs no
+ * weights; a mixture of trees, such as a SparseMAP solution, has one
+ * (differentiable) weight per tree. */
+struct GCNGraph
+{
+    GCNGraph(const dy::Expression& adj)
+      : adj{ adj }
+    {}
+
+    GCNGraph(std::vector<unsigned> heads)
+      : trees{ std::move(heads) }
+    {}
+
+    GCNGraph(std::vector<std::vector<unsigned>> trees,
+             const dy::Expression& weights)
+      : trees{ std::move(trees) }
+      , weights{ weights }
+      , weighted{ true }
+    {}
+
+    bool is_sparse() const { return !trees.empty(); }
+
+    dy::Expression adj;
+    std::vector<std::vector<unsigned>> trees;
+    dy::Expression weights;
+    bool weighted = false;
+};
+
 struct GCNSettings
 {
     unsigned dim;
@@ -31,17 +62,15 @@ struct GCNParams {
     dy::Parameter b_self;
 };
 
+/* The parameters of a layer stacked as [self; parents; children], so
+ * that a layer takes a single product with its input. */
 struct GCNExprs {
 
     GCNExprs() = default;
     GCNExprs(dy::ComputationGraph& cg, GCNParams params);
 
-    dy::Expression W_parents;
-    dy::Expression b_parents;
-    dy::Expression W_children;
-    dy::Expression b_children;
-    dy::Expression W_self;
-    dy::Expression b_self;
+    dy::Expression W;
+    dy::Expression b;
 };
 
 
@@ -54,7 +83,15 @@ struct GCNBuilder
                bool dense);
 
     void new_graph(dy::ComputationGraph& cg, bool training);
-    dy::Expression apply(const dy::Expression &input, const dy::Expression& graph);
+    dy::Expression apply(const dy::Expression &input, const GCNGraph& graph);
+
+    /* A minibatch at once: the sentences are concatenated column-wise
+     * into one block-diagonal graph, so that a layer is a single product
+     * and a single sparse aggregation. Same results as apply() on each
+     * sentence, which it falls back to for dense adjacencies. */
+    std::vector<dy::Expression>
+    apply_batch(const std::vector<dy::Expression>& inputs,
+                const std::vector<GCNGraph>& graphs);
 
     void set_dropout(float value);
 
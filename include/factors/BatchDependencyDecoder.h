@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * MAP decoding of many dependency trees at once.
+ *
+ * Arc scores of a whole batch are stored structure-of-arrays: the score of
+ * arc h -> m in sentence b lives at scores[(h * length + m) * batch_size + b],
+ * so every inner loop of Eisner and of the best-incoming-arc step runs over
+ * the sentences of the batch and can be vectorized. Sentences shorter than
+ * the batch length are padded with a chain of zero-score arcs hanging off
+ * their last word, which leaves their best tree unchanged.
+ */
+
+#include <cstddef>
+#include <vector>
+
+class BatchDependencyDecoder
+{
+  public:
+    /* Prepare for a batch of sentences of at most `length` tokens
+     * (root included). Previous scores are discarded. */
+    void reset(int length, int batch_size);
+
+    /* Copy the (n x n) score matrix of sentence b, column-major with
+     * scores[m * n + h] the score of arc h -> m, as stored by dynet. */
+    void set_scores(int b, int n, const float* scores);
+
+    /* Projective decoding with a single root attachment, as
+     * DependencyDecoder::RunEisner. */
+    void run_eisner(std::vector<std::vector<int>>* heads,
+                    std::vector<double>* values);
+
+    /* Non-projective decoding. The best incoming arcs are picked for all
+     * sentences at once; sentences whose greedy graph has a cycle fall back
+     * to the contracting DependencyDecoder::RunChuLiuEdmonds. */
+    void run_chu_liu_edmonds(std::vector<std::vector<int>>* heads,
+                             std::vector<double>* values);
+
+    int length() const { return length_; }
+    int batch_size() const { return batch_size_; }
+
+  private:
+    size_t ix(int h, int m) const
+    {
+        return (static_cast<size_t>(h) * length_ + m) * batch_size_;
+    }
+
+    void backtrack(int b, int h, int m, bool complete, std::vector<int>* heads);
+
+    int length_ = 0;
+    int batch_size_ = 0;
+    std::vector<int> lengths_;
+
+    std::vector<double> scores_;
+
+    // Eisner chart, laid out like the scores.
+    std::vector<double> complete_;
+    std::vector<double> incomplete_;
+    std::vector<int> complete_bt_;
+    std::vector<int> incomplete_bt_;
+
+    // one entry per sentence
+    std::vector<double> best_;
+    std::vector<int> arg_;
+};
@@ -33,6 +33,15 @@ public:
                         vector<int> *heads,
                         double *value);
 
+  // Chu-Liu-Edmonds over a dense score matrix, contracting cycles in
+  // place of candidate lists. Same result as RunChuLiuEdmonds, but faster
+  // when (nearly) all arcs are present.
+  void RunChuLiuEdmondsDense(int sentence_length,
+                             const vector<vector<int> > &index_arcs,
+                             const vector<double> &scores,
+                             vector<int> *heads,
+                             double *value);
+
   void RunEisner(int sentence_length,
                  int num_arcs,
                  const vector<vector<int> > &index_arcs,
@@ -40,6 +49,15 @@ public:
                  vector<int> *heads,
                  double *value);
 
+  // Eisner's algorithm where every word (and the root) has at most
+  // max_valency modifiers in total. Runs in O(n^3 max_valency^2).
+  void RunEisnerValency(int sentence_length,
+                        const vector<vector<int> > &index_arcs,
+                        const vector<double> &scores,
+                        int max_valency,
+                        vector<int> *heads,
+                        double *value);
+
   void RunChuLiuEdmondsIteration(vector<bool> *disabled,
                                  vector<vector<int> > *candidate_heads,
                                  vector<vector<double> > *candidate_scores,
@@ -51,4 +69,22 @@ public:
                           const vector<vector<int> > &index_arcs,
                           int h, int m, bool complete, vector<int> *heads);
 
+private:
+  void RunChuLiuEdmondsDenseIteration(int length,
+                                      const vector<double> &weights,
+                                      vector<int> *heads);
+
+  void RunEisnerValencyBacktrack(int h, int m, int a, int b, bool complete,
+                                 vector<int> *heads);
+
+  // Charts for RunEisnerValency, indexed by [h][m][a] (complete) and
+  // [h][m][a][b] (incomplete), where a is the number of modifiers of h on
+  // the side of m and b the number of modifiers of m on the side of h.
+  int valency_length_;
+  int valency_width_;
+  vector<double> valency_complete_;
+  vector<double> valency_incomplete_;
+  vector<int> valency_complete_backtrack_;
+  vector<int> valency_incomplete_backtrack_;
+
 };
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <ad3/FactorGraph.h>
+
+using std::vector;
+
+
+namespace sparsemap {
+
+    /* Bump allocator for the factors of per-sample factor graphs.
+     *
+     * Factors are constructed in large blocks and declared to their graph
+     * without passing ownership; reset() destroys all of them at once and
+     * rewinds, keeping the blocks for the next batch, so steady-state
+     * training does no allocation for factor objects. A graph built with
+     * an arena must not run (forward or backward) after the arena is
+     * reset: builders reset theirs in new_graph, when the previous
+     * ComputationGraph is gone. The graph itself may outlive the reset,
+     * since it does not touch factors it does not own when destroyed.
+     *
+     * The BinaryVariables are still allocated by AD3::FactorGraph. */
+    class FactorArena {
+
+        public:
+        explicit FactorArena(size_t block_size = 1 << 16)
+            : block_size_(block_size) {}
+
+        FactorArena(const FactorArena&) = delete;
+        FactorArena& operator=(const FactorArena&) = delete;
+
+        /* blocks keep their addresses: moving does not invalidate the
+         * factors, and leaves the source empty */
+        FactorArena(FactorArena&&) = default;
+        FactorArena& operator=(FactorArena&& other) {
+            if (this != &other) {
+                reset();
+                block_size_ = other.block_size_;
+                blocks_ = std::move(other.blocks_);
+                current_ = other.current_;
+                offset_ = other.offset_;
+                dtors_ = std::move(other.dtors_);
+                other.blocks_.clear();
+                other.dtors_.clear();
+                other.current_ = other.offset_ = 0;
+            }
+            return *this;
+        }
+
+        ~FactorArena() { reset(); }
+
+        /* construct an F in the arena; destroyed on reset */
+        template <class F, class... Args>
+        F* create(Args&&... args) {
+            void* mem = allocate(sizeof(F), alignof(F));
+            F* obj = new (mem) F(std::forward<Args>(args)...);
+            dtors_.emplace_back(obj, [](void* p) {
+                static_cast<F*>(p)->~F();
+            });
+            return obj;
+        }
+
+        /* create an F and declare it to fg over vars, owned by the arena */
+        template <class F>
+        F* declare(AD3::FactorGraph* fg,
+                   const vector<AD3::BinaryVariable*>& vars) {
+            F* factor = create<F>();
+            fg->DeclareFactor(factor, vars, /*owned_by_graph=*/false);
+            return factor;
+        }
+
+        /* destroy everything, newest first, and rewind to the first block */
+        void reset() {
+            for (auto it = dtors_.rbegin(); it != dtors_.rend(); ++it)
+                it->second(it->first);
+            dtors_.clear();
+            current_ = 0;
+            offset_ = 0;
+        }
+
+        /* number of live objects */
+        size_t size() const { return dtors_.size(); }
+
+        private:
+
+        void* allocate(size_t size, size_t align) {
+            while (current_ < blocks_.size()) {
+                auto& block = blocks_[current_];
+                auto base = reinterpret_cast<std::uintptr_t>(block.first.get());
+                size_t start = (base + offset_ + align - 1) / align * align
+                             - base;
+                if (start + size <= block.second) {
+                    offset_ = start + size;
+                    return block.first.get() + start;
+                }
+                ++current_;
+                offset_ = 0;
+            }
+
+            /* new block, larger than usual if one object does not fit */
+            size_t cap = std::max(block_size_, size + align);
+            blocks_.emplace_back(std::unique_ptr<char[]>(new char[cap]), cap);
+            current_ = blocks_.size() - 1;
+            offset_ = 0;
+            return allocate(size, align);
+        }
+
+        size_t block_size_;
+        vector<std::pair<std::unique_ptr<char[]>, size_t> > blocks_;
+        size_t current_ = 0, offset_ = 0;
+        vector<std::pair<void*, void (*)(void*)> > dtors_;
+    };
+} // namespace sparsemap
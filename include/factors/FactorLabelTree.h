@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <ad3/GenericFactor.h>
+
+using AD3::GenericFactor;
+using AD3::Configuration;
+using std::vector;
+
+
+namespace sparsemap {
+
+    /* Binary labels whose pairwise interactions follow a forest.
+     *
+     * Variable l is label l. Every label l with a parent p = parents[l]
+     * has one edge (p, l), scoring additional potential edge(l) when both
+     * labels are on; edges are numbered by increasing child. A
+     * configuration holds the 0/1 state of every label. The MAP is exact,
+     * by max-product from the leaves up, in O(L). */
+    class FactorLabelTree : public GenericFactor {
+
+        protected:
+
+        vector<int>* cfg_cast(Configuration cfg) {
+            return static_cast<vector<int> *>(cfg);
+        }
+
+        public:
+        FactorLabelTree () {}
+        virtual ~FactorLabelTree() { ClearActiveSet(); }
+
+        void Evaluate(const vector<double> &variable_log_potentials,
+                      const vector<double> &additional_log_potentials,
+                      const Configuration configuration,
+                      double *value) {
+
+            const vector<int>* y = cfg_cast(configuration);
+            *value = 0;
+            for (int l = 0; l < n_labels_; ++l) {
+                if (!(*y)[l])
+                    continue;
+                *value += variable_log_potentials[l];
+                int p = parents_[l];
+                if (p >= 0 && (*y)[p])
+                    *value += additional_log_potentials[edge_[l]];
+            }
+        }
+
+        void Maximize(const vector<double> &variable_log_potentials,
+                      const vector<double> &additional_log_potentials,
+                      Configuration &configuration,
+                      double *value) {
+
+            /* best[2l + s]: best score of the subtree of l, with l in
+             * state s; take[2l + s]: state of l under a parent in s */
+            for (int l = 0; l < n_labels_; ++l) {
+                best_[2 * l] = 0;
+                best_[2 * l + 1] = variable_log_potentials[l];
+            }
+
+            /* children before parents */
+            for (auto l : post_order_) {
+                int p = parents_[l];
+                if (p < 0)
+                    continue;
+                double off = best_[2 * l];
+                double on = best_[2 * l + 1];
+                double on_both = on + additional_log_potentials[edge_[l]];
+
+                take_[2 * l] = on > off;
+                best_[2 * p] += take_[2 * l] ? on : off;
+                take_[2 * l + 1] = on_both > off;
+                best_[2 * p + 1] += take_[2 * l + 1] ? on_both : off;
+            }
+
+            /* roots pick their best state, then down the tree */
+            vector<int>* y = cfg_cast(configuration);
+            y->resize(n_labels_);
+            *value = 0;
+            for (auto it = post_order_.rbegin(); it != post_order_.rend();
+                 ++it) {
+                int l = *it, p = parents_[l];
+                if (p >= 0) {
+                    (*y)[l] = take_[2 * l + (*y)[p]];
+                    continue;
+                }
+                (*y)[l] = best_[2 * l + 1] > best_[2 * l];
+                *value += best_[2 * l + (*y)[l]];
+            }
+        }
+
+        void UpdateMarginalsFromConfiguration(
+                const Configuration &configuration,
+                double weight,
+                vector<double> *variable_posteriors,
+                vector<double> *additional_posteriors) {
+
+            const vector<int>* y = cfg_cast(configuration);
+            for (int l = 0; l < n_labels_; ++l) {
+                if (!(*y)[l])
+                    continue;
+                (*variable_posteriors)[l] += weight;
+                int p = parents_[l];
+                if (p >= 0 && (*y)[p])
+                    (*additional_posteriors)[edge_[l]] += weight;
+            }
+        }
+
+        /* labels on in both: the inner product of the variable parts */
+        int CountCommonValues(const Configuration &configuration1,
+                              const Configuration &configuration2) {
+            const vector<int>* y1 = cfg_cast(configuration1);
+            const vector<int>* y2 = cfg_cast(configuration2);
+            int common = 0;
+            for (int l = 0; l < n_labels_; ++l)
+                if ((*y1)[l] && (*y2)[l])
+                    common += 1;
+            return common;
+        }
+
+        bool SameConfiguration(const Configuration &configuration1,
+                               const Configuration &configuration2) {
+            return *cfg_cast(configuration1) == *cfg_cast(configuration2);
+        }
+
+        void DeleteConfiguration(Configuration configuration) {
+            delete cfg_cast(configuration);
+        }
+
+        Configuration CreateConfiguration() {
+            vector<int>* config = new vector<int>(n_labels_, 0);
+            return static_cast<Configuration>(config);
+        }
+
+        /* parents[l] is the parent label of l, or -1 for a root */
+        void Initialize(const vector<int>& parents) {
+            parents_ = parents;
+            n_labels_ = parents.size();
+
+            n_edges_ = 0;
+            edge_.assign(n_labels_, -1);
+            vector<vector<int> > children(n_labels_);
+            vector<int> stack;
+            for (int l = 0; l < n_labels_; ++l) {
+                if (parents_[l] >= 0) {
+                    edge_[l] = n_edges_++;
+                    children[parents_[l]].push_back(l);
+                } else
+                    stack.push_back(l);
+            }
+
+            post_order_.clear();
+            while (!stack.empty()) {
+                int l = stack.back();
+                stack.pop_back();
+                post_order_.push_back(l);
+                for (auto c : children[l])
+                    stack.push_back(c);
+            }
+            std::reverse(post_order_.begin(), post_order_.end());
+
+            best_.resize(2 * n_labels_);
+            take_.resize(2 * n_labels_);
+        }
+
+        virtual size_t GetNumAdditionals() override { return n_edges_; }
+
+        private:
+        int n_labels_ = 0, n_edges_ = 0;
+        vector<int> parents_, edge_, post_order_;
+
+        /* workspaces reused across calls */
+        vector<double> best_;
+        vector<int> take_;
+    };
+} // namespace sparsemap
@@ -1,8 +1,8 @@
 #pragma once
 
-#include <limits>
 #include <algorithm>
-#include <iterator>
+#include <cmath>
+#include <vector>
 
 #include <ad3/GenericFactor.h>
 
@@ -19,7 +19,14 @@ namespace sparsemap {
 
         protected:
 
-        int ix(int i, int j) { return cols_ * i + j; }
+        /* index of the variable for pair (i, j) */
+        int ix(int i, int j) {
+            if (!sparse_)
+                return cols_ * i + j;
+            auto first = allowed_[i].begin();
+            auto it = std::lower_bound(first, allowed_[i].end(), j);
+            return offsets_[i] + (it - first);
+        }
 
         vector<int>* cfg_cast(Configuration cfg) {
             return static_cast<vector<int> *>(cfg);
@@ -27,7 +34,10 @@ namespace sparsemap {
 
         public:
         FactorMatching () {}
-        virtual ~FactorMatching() { ClearActiveSet(); }
+        virtual ~FactorMatching() {
+            ClearActiveSet();
+            lapjv_workspace_free(&workspace_);
+        }
 
         void Evaluate(const vector<double> &variable_log_potentials,
                       const vector<double>&,
@@ -49,50 +59,103 @@ namespace sparsemap {
                       Configuration &configuration,
                       double *value) {
 
-            int n = rows_ > cols_ ? rows_ : cols_;
-            vector<vector<double> > byrow;
-            vector<double*> cost_ptr;
-            byrow.resize(n);
-
-            /* if needed, will pad up to square matrix with highest cost */
-            double pad = 0;
-            if (cols_ != rows_) {
-                auto min_elem = std::min_element(std::begin(variable_log_potentials),
-                                                 std::end(variable_log_potentials));
-                pad = -(*min_elem) + 1;
+            if (sparse_) {
+                MaximizeSparse(variable_log_potentials,
+                               additional_log_potentials,
+                               configuration,
+                               value);
+                return;
             }
 
-            for (int i = 0; i < rows_; ++i) {
-                byrow[i].resize(n);
-                for (int j = 0; j < cols_; ++j)
-                    byrow[i][j] = -variable_log_potentials[ix(i, j)];
+            SetCosts(variable_log_potentials);
+
+            /* reuse a solution handed in with SetSolved, else warm start
+             * LAPJV from the duals of the previous call. The auction is
+             * always cold: started from stale prices without the
+             * epsilon-scaling phases, rows fight over the equal-cost
+             * padding columns of a rectangular problem for many bids. */
+            bool reuse = solved_ && cost_ == solved_cost_;
+            if (!reuse && auction_eps_ > 0)
+                auction_warm(n_, cost_ptr_.data(), x_.data(), y_.data(),
+                             v_.data(), auction_eps_, FALSE, &workspace_);
+            else if (!reuse)
+                lapjv_warm(n_, cost_ptr_.data(), x_.data(), y_.data(),
+                           v_.data(), warm_, &workspace_);
+            warm_ = true;
+            solved_ = false;
 
-                /* fill remaining columns */
-                if (cols_ < rows_) {
-                    for (int j = cols_; j < rows_; ++j)
-                        byrow[i][j] = pad;
-                }
+            vector<int> *cfg_vec = cfg_cast(configuration);
+            cfg_vec->resize(rows_);
+            for (int i = 0; i < rows_; ++i)
+                (*cfg_vec)[i] = x_[i] < cols_ ? x_[i] : -1;
 
-                cost_ptr.push_back(byrow[i].data());
-            }
+            Evaluate(variable_log_potentials,
+                     additional_log_potentials,
+                     configuration,
+                     value);
+        }
 
-            /* fill remaining rows */
-            if (rows_ < cols_)
-                for (int i = rows_; i < cols_; ++i) {
-                    byrow[i].assign(n, pad);
-                    cost_ptr.push_back(byrow[i].data());
-                }
+        /* Solve the dense MAP by auction instead of LAPJV, stopping at
+         * eps-optimality: the matching found is then within
+         * max(rows, cols) * eps of the best one. eps <= 0 uses LAPJV. */
+        void SetAuction(double eps) { auction_eps_ = eps; }
+
+        /* The dense MAP may be solved outside of the factor, e.g. for a
+         * whole batch of factors at once with lapjv_batch: SetCosts fills
+         * the size() x size() matrix costs() for potentials eta, the caller
+         * solves it into row_solution(), col_solution() and duals(), and
+         * SetSolved records it. Maximize at the same potentials then
+         * reuses the solution, and otherwise warm-starts from its duals. */
+        void SetCosts(const vector<double> &eta) {
+            /* padding rows / columns keep the constant cost set in
+             * Initialize: any constant gives the same optimal matching. */
+            for (int i = 0; i < rows_; ++i)
+                for (int j = 0; j < cols_; ++j)
+                    cost_[n_ * i + j] = -eta[ix(i, j)];
+        }
 
-            vector<int> x_c, y_c;
-            x_c.reserve(n);
-            y_c.reserve(n);
+        int size() const { return n_; }
+        double** costs() { return cost_ptr_.data(); }
+        int* row_solution() { return x_.data(); }
+        int* col_solution() { return y_.data(); }
+        double* duals() { return v_.data(); }
 
-            lapjv_internal(n, cost_ptr.data(), x_c.data(), y_c.data());
+        void SetSolved() {
+            solved_cost_ = cost_;
+            solved_ = true;
+            warm_ = true;
+        }
 
-            vector<int> *cfg_vec = cfg_cast(configuration);
+        /* Sparse assignment on the (rows + cols) x (cols + rows) slack
+         * problem built in Initialize: real row i may take an allowed
+         * column or its own slack column c + i at a large cost; slack row
+         * r + j takes column j or the slack column of a row allowed on j.
+         * This is always feasible, and unassigns as few rows as possible. */
+        void MaximizeSparse(const vector<double> &variable_log_potentials,
+                            const vector<double> &additional_log_potentials,
+                            Configuration &configuration,
+                            double *value) {
+
+            double big = 1;
             for (int i = 0; i < rows_; ++i) {
-                cfg_vec->push_back(x_c[i] < cols_ ? x_c[i] : -1);
+                double row_max = 0;
+                for (size_t k = 0; k < allowed_[i].size(); ++k) {
+                    double eta = variable_log_potentials[offsets_[i] + k];
+                    cc_[ii_[i] + k] = -eta;
+                    row_max = std::max(row_max, std::abs(eta));
+                }
+                big += 2 * row_max;
             }
+            for (int i = 0; i < rows_; ++i)
+                cc_[ii_[i + 1] - 1] = big;
+
+            lapmod_internal(n_, cc_.data(), ii_.data(), kk_.data(),
+                            x_.data(), y_.data(), FP_DYNAMIC);
+
+            vector<int> *cfg_vec = cfg_cast(configuration);
+            cfg_vec->resize(rows_);
+            for (int i = 0; i < rows_; ++i)
+                (*cfg_vec)[i] = x_[i] < cols_ ? x_[i] : -1;
 
             Evaluate(variable_log_potentials,
                      additional_log_potentials,
@@ -156,10 +219,87 @@ namespace sparsemap {
         void Initialize(int rows, int cols) {
             rows_ = rows;
             cols_ = cols;
+            n_ = rows_ > cols_ ? rows_ : cols_;
+
+            cost_.assign(n_ * n_, 0);
+            cost_ptr_.resize(n_);
+            for (int i = 0; i < n_; ++i)
+                cost_ptr_[i] = cost_.data() + n_ * i;
+
+            x_.resize(n_);
+            y_.resize(n_);
+            v_.resize(n_);
+            warm_ = false;
+            solved_ = false;
+            sparse_ = false;
+            lapjv_workspace_reserve(&workspace_, n_);
+        }
+
+        /* Row i may only be matched to the (sorted) columns allowed[i].
+         * Variables are the allowed pairs, row by row. Rows that cannot be
+         * matched within the pattern are left unassigned. */
+        void Initialize(int rows, int cols,
+                        const vector<vector<int> >& allowed) {
+            rows_ = rows;
+            cols_ = cols;
+            sparse_ = true;
+            allowed_ = allowed;
+
+            offsets_.resize(rows);
+            int n_vars = 0;
+            for (int i = 0; i < rows; ++i) {
+                offsets_[i] = n_vars;
+                n_vars += allowed[i].size();
+            }
+
+            /* rows allowed on each column, for the slack rows */
+            vector<vector<int> > allowed_on(cols);
+            for (int i = 0; i < rows; ++i)
+                for (auto j : allowed[i])
+                    allowed_on[j].push_back(i);
+
+            n_ = rows + cols;
+            ii_.assign(1, 0);
+            kk_.clear();
+            for (int i = 0; i < rows; ++i) {
+                for (auto j : allowed[i])
+                    kk_.push_back(j);
+                kk_.push_back(cols + i);
+                ii_.push_back(kk_.size());
+            }
+            for (int j = 0; j < cols; ++j) {
+                kk_.push_back(j);
+                for (auto i : allowed_on[j])
+                    kk_.push_back(cols + i);
+                ii_.push_back(kk_.size());
+            }
+            cc_.assign(kk_.size(), 0);
+
+            x_.resize(n_);
+            y_.resize(n_);
         }
 
         private:
         int rows_, cols_;
 
+        /* sparsity pattern, if any, and the CSR slack problem */
+        bool sparse_ = false;
+        vector<vector<int> > allowed_;
+        vector<int> offsets_;
+        vector<uint_t> ii_, kk_;
+        vector<double> cc_;
+
+        /* LAPJV state, kept across calls */
+        int n_;
+        vector<double> cost_;
+        vector<double*> cost_ptr_;
+        vector<int> x_, y_;
+        vector<double> v_;
+        bool warm_ = false;
+        bool solved_ = false;
+        double auction_eps_ = 0;
+        vector<double> solved_cost_;
+        lapjv_workspace_t workspace_ = { 0, 0, 0, 0, 0, 0 };
+
     };
 } // namespace sparsemap
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <ad3/Factor.h>
+
+using AD3::Factor;
+using std::vector;
+
+
+namespace sparsemap {
+
+    /* Many PAIR factors at once, with tied edge potentials.
+     *
+     * Pair k links variables 2k and 2k + 1 of the factor (the same
+     * variable may appear in many pairs) and scores their conjunction
+     * with additional potential group(k), so a whole family of pairs
+     * shares one weight instead of one copy per pair. Pairs do not
+     * interact inside the factor: MAP and QP are solved pair by pair in
+     * closed form, in flat loops over the link arrays. The additional
+     * posterior of a group is the sum of its pairs' conjunction
+     * marginals, which is also the gradient wrt the tied weight. */
+    class FactorPairBundle : public Factor {
+
+        protected:
+
+        /* argmin over [0, 1]^2 of (a - u1)^2 / 2 + (b - u2)^2 / 2
+         * - w min(a, b), for w >= 0, with the derivatives of a and b
+         * wrt (u1, u2, w). Off the diagonal the two halves decouple;
+         * near it, a = b = (u1 + u2 + w) / 2. */
+        static void SolveAttractive(double u1, double u2, double w,
+                                    double* a, double* b,
+                                    double* da = nullptr,
+                                    double* db = nullptr) {
+            double d = u1 - u2;
+            double t = (u1 + u2 + w) / 2;
+            bool above = d > w, below = d < -w;
+            double a0 = above ? u1 : (below ? u1 + w : t);
+            double b0 = above ? u2 + w : (below ? u2 : t);
+            *a = std::min(1.0, std::max(0.0, a0));
+            *b = std::min(1.0, std::max(0.0, b0));
+            if (!da)
+                return;
+
+            double ia = (a0 > 0 && a0 < 1) ? 1 : 0;
+            double ib = (b0 > 0 && b0 < 1) ? 1 : 0;
+            double half = (above || below) ? 0 : .5;
+            da[0] = above ? ia : (below ? ia : half * ia);
+            da[1] = above ? 0 : (below ? 0 : half * ia);
+            da[2] = above ? 0 : (below ? ia : half * ia);
+            db[0] = above ? 0 : (below ? 0 : half * ib);
+            db[1] = above ? ib : (below ? ib : half * ib);
+            db[2] = above ? ib : (below ? 0 : half * ib);
+        }
+
+        /* QP for one pair. A negative weight is reduced to a positive one
+         * by flipping the second variable (b' = 1 - b), under which
+         * max(0, a + b - 1) = a - min(a, b'). */
+        static void SolvePair(double u1, double u2, double w,
+                              double* a, double* b, double* ab,
+                              double* da = nullptr, double* db = nullptr) {
+            bool flip = w < 0;
+            double fu1 = flip ? u1 + w : u1;
+            double fu2 = flip ? 1 - u2 : u2;
+            double fw = flip ? -w : w;
+
+            double fb, fda[3], fdb[3];
+            SolveAttractive(fu1, fu2, fw, a, &fb,
+                            da ? fda : nullptr, da ? fdb : nullptr);
+            *b = flip ? 1 - fb : fb;
+            *ab = flip ? *a - std::min(*a, fb) : std::min(*a, fb);
+            if (!da)
+                return;
+
+            /* back through the change of variables, then b = 1 - b' */
+            double s = flip ? -1 : 1;
+            da[0] = fda[0];
+            da[1] = s * fda[1];
+            da[2] = flip ? fda[0] - fda[2] : fda[2];
+            db[0] = s * fdb[0];
+            db[1] = fdb[1];
+            db[2] = s * (flip ? fdb[0] - fdb[2] : fdb[2]);
+        }
+
+        public:
+        FactorPairBundle () {}
+        virtual ~FactorPairBundle() {}
+
+        int type() { return AD3::FactorTypes::FACTOR_PAIR; }
+
+        /* group[k] in [0, num_groups) is the tied weight of pair k. */
+        void Initialize(const vector<int>& group, int num_groups) {
+            group_ = group;
+            num_groups_ = num_groups;
+        }
+
+        int GetNumPairs() const { return group_.size(); }
+
+        virtual size_t GetNumAdditionals() override { return num_groups_; }
+
+        void Evaluate(const vector<double> &variable_log_potentials,
+                      const vector<double> &additional_log_potentials,
+                      const vector<double> &configuration,
+                      double *value) {
+            *value = 0;
+            for (size_t k = 0; k < group_.size(); ++k) {
+                double x1 = configuration[2 * k];
+                double x2 = configuration[2 * k + 1];
+                *value += x1 * variable_log_potentials[2 * k]
+                        + x2 * variable_log_potentials[2 * k + 1]
+                        + x1 * x2 * additional_log_potentials[group_[k]];
+            }
+        }
+
+        void SolveMAP(const vector<double> &variable_log_potentials,
+                      const vector<double> &additional_log_potentials,
+                      vector<double> *variable_posteriors,
+                      vector<double> *additional_posteriors,
+                      double *value) {
+            size_t n_pairs = group_.size();
+            variable_posteriors->assign(2 * n_pairs, 0);
+            additional_posteriors->assign(num_groups_, 0);
+            *value = 0;
+
+            for (size_t k = 0; k < n_pairs; ++k) {
+                double u1 = variable_log_potentials[2 * k];
+                double u2 = variable_log_potentials[2 * k + 1];
+                double both = u1 + u2 + additional_log_potentials[group_[k]];
+
+                /* best of 00, 10, 01 and 11 */
+                double one = std::max(u1, u2);
+                bool pick_both = both > std::max(0.0, one);
+                bool pick_one = !pick_both && one > 0;
+                bool first = u1 >= u2;
+
+                (*variable_posteriors)[2 * k] =
+                    pick_both || (pick_one && first);
+                (*variable_posteriors)[2 * k + 1] =
+                    pick_both || (pick_one && !first);
+                (*additional_posteriors)[group_[k]] += pick_both;
+                *value += pick_both ? both : (pick_one ? one : 0);
+            }
+        }
+
+        void SolveQP(const vector<double> &variable_log_potentials,
+                     const vector<double> &additional_log_potentials,
+                     vector<double> *variable_posteriors,
+                     vector<double> *additional_posteriors) {
+            size_t n_pairs = group_.size();
+            variable_posteriors->resize(2 * n_pairs);
+            additional_posteriors->assign(num_groups_, 0);
+
+            for (size_t k = 0; k < n_pairs; ++k) {
+                double ab;
+                SolvePair(variable_log_potentials[2 * k],
+                          variable_log_potentials[2 * k + 1],
+                          additional_log_potentials[group_[k]],
+                          &(*variable_posteriors)[2 * k],
+                          &(*variable_posteriors)[2 * k + 1],
+                          &ab);
+                (*additional_posteriors)[group_[k]] += ab;
+            }
+
+            /* the backward pass linearizes around this point */
+            last_variable_ = variable_log_potentials;
+            last_additional_ = additional_log_potentials;
+        }
+
+        /* Product of the Jacobian of the last SolveQP solution with v:
+         * out = d mu / d eta_u v (symmetric), and out_v = (d mu / d eta_v)'
+         * v, the tied weights collecting the terms of all their pairs. */
+        void JacobianVec(const vector<double> &v,
+                         vector<double> &out,
+                         vector<double> &out_v) {
+            size_t n_pairs = group_.size();
+            out.assign(2 * n_pairs, 0);
+            out_v.assign(num_groups_, 0);
+
+            for (size_t k = 0; k < n_pairs; ++k) {
+                double a, b, ab, da[3], db[3];
+                SolvePair(last_variable_[2 * k],
+                          last_variable_[2 * k + 1],
+                          last_additional_[group_[k]],
+                          &a, &b, &ab, da, db);
+                double va = v[2 * k], vb = v[2 * k + 1];
+                out[2 * k] = da[0] * va + db[0] * vb;
+                out[2 * k + 1] = da[1] * va + db[1] * vb;
+                out_v[group_[k]] += da[2] * va + db[2] * vb;
+            }
+        }
+
+        private:
+        vector<int> group_;
+        int num_groups_ = 0;
+        vector<double> last_variable_, last_additional_;
+    };
+} // namespace sparsemap
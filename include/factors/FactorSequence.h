@@ -19,6 +19,7 @@
 // along with AD3 2.1.  If not, see <http://www.gnu.org/licenses/>.
 
 
+#include <cassert>
 #include <vector>
 #include <limits>
 #include "ad3/GenericFactor.h"
@@ -49,6 +50,74 @@ class FactorSequence : public GenericFactor {
     return additional_log_potentials[index];
   }
 
+  // Best previous state for every current state: values[k] is the max
+  // over l of previous[l] + transitions[l * num_states + k], and path[k]
+  // its argmax. Previous states are the outer loop, so that the inner one
+  // runs over contiguous current states and is vectorized by the
+  // compiler. Ties go to the first previous state.
+  void RelaxFromPrevious(int num_previous,
+                         int num_states,
+                         const double *previous,
+                         const double *transitions,
+                         double *values,
+                         int *path) {
+    for (int k = 0; k < num_states; ++k) {
+      values[k] = previous[0] + transitions[k];
+      path[k] = 0;
+    }
+    for (int l = 1; l < num_previous; ++l) {
+      const double from = previous[l];
+      const double *row = transitions + l * num_states;
+      for (int k = 0; k < num_states; ++k) {
+        double val = from + row[k];
+        bool better = val > values[k];
+        values[k] = better ? val : values[k];
+        path[k] = better ? l : path[k];
+      }
+    }
+  }
+
+  // Path (state sequence) backtracking through path_, from the best last
+  // state.
+  void Backtrack(int best, Configuration configuration) {
+    int length = num_states_.size();
+    vector<int> *sequence = static_cast<vector<int>*>(configuration);
+    assert(sequence->size() == length);
+    (*sequence)[length - 1] = best;
+    for (int i = length - 1; i > 0; --i) {
+      (*sequence)[i - 1] = path_[offset_states_[i] + (*sequence)[i]];
+    }
+  }
+
+  // Flatten index_edges_ into the tables read by Maximize, and size the
+  // workspaces reused across calls. To be called at the end of
+  // Initialize, also by derived factors.
+  void BuildFlatIndex() {
+    int length = num_states_.size();
+    start_edges_ = index_edges_[0][0];
+    stop_edges_.resize(num_states_[length - 1]);
+    for (int l = 0; l < num_states_[length - 1]; ++l) {
+      stop_edges_[l] = index_edges_[length][l][0];
+    }
+
+    // edges into each position i > 0, previous-state-major
+    flat_edges_.clear();
+    offset_transitions_.assign(length, 0);
+    for (int i = 1; i < length; ++i) {
+      offset_transitions_[i] = flat_edges_.size();
+      for (int l = 0; l < num_states_[i - 1]; ++l) {
+        for (int k = 0; k < num_states_[i]; ++k) {
+          flat_edges_.push_back(index_edges_[i][l][k]);
+        }
+      }
+    }
+
+    transitions_.resize(flat_edges_.size());
+    stop_transitions_.resize(num_states_[length - 1]);
+    values_.resize(offset_states_[length - 1] + num_states_[length - 1]);
+    path_.resize(values_.size());
+  }
+
   void AddNodePosterior(int position,
                         int state,
                         double weight,
@@ -77,69 +146,45 @@ class FactorSequence : public GenericFactor {
                 const vector<double> &additional_log_potentials,
                 Configuration &configuration,
                 double *value) {
-    // Decode using the Viterbi algorithm.
+    // Decode using the Viterbi algorithm, on the flat tables built by
+    // BuildFlatIndex.
     int length = num_states_.size();
-    vector<vector<double> > values(length);
-    vector<vector<int> > path(length);
+
+    // Transition scores, as dense matrices for each position.
+    for (size_t e = 0; e < flat_edges_.size(); ++e) {
+      transitions_[e] = additional_log_potentials[flat_edges_[e]];
+    }
 
     // Initialization.
-    int num_states = num_states_[0];
-    values[0].resize(num_states);
-    path[0].resize(num_states);
-    for (int l = 0; l < num_states; ++l) {
-      values[0][l] =
-        GetNodeScore(0, l, variable_log_potentials,
-                     additional_log_potentials) +
-        GetEdgeScore(0, 0, l, variable_log_potentials,
-                     additional_log_potentials);
-      path[0][l] = -1; // This won't be used.
+    for (int l = 0; l < num_states_[0]; ++l) {
+      values_[l] = variable_log_potentials[l] +
+        additional_log_potentials[start_edges_[l]];
+      path_[l] = -1; // This won't be used.
     }
 
     // Recursion.
-    for (int i = 0; i < length - 1; ++i) {
-      int num_states = num_states_[i + 1];
-      values[i + 1].resize(num_states);
-      path[i + 1].resize(num_states);
-      for (int k = 0; k < num_states; ++k) {
-        double best_value = -std::numeric_limits<double>::infinity();
-        int best = -1;
-        for (int l = 0; l < num_states_[i]; ++l) {
-          double val = values[i][l] +
-            GetEdgeScore(i+1, l, k, variable_log_potentials,
-                         additional_log_potentials);
-          if (best < 0 || val > best_value) {
-            best_value = val;
-            best = l;
-          }
-        }
-        values[i+1][k] = best_value +
-          GetNodeScore(i+1, k, variable_log_potentials,
-                       additional_log_potentials);
-        path[i+1][k] = best;
+    for (int i = 1; i < length; ++i) {
+      int offset = offset_states_[i];
+      RelaxFromPrevious(num_states_[i - 1], num_states_[i],
+                        &values_[offset_states_[i - 1]],
+                        &transitions_[offset_transitions_[i]],
+                        &values_[offset], &path_[offset]);
+      for (int k = 0; k < num_states_[i]; ++k) {
+        values_[offset + k] += variable_log_potentials[offset + k];
       }
     }
 
     // Termination.
-    double best_value = -std::numeric_limits<double>::infinity();
-    int best = -1;
-    for (int l = 0; l < num_states_[length - 1]; ++l) {
-      double val = values[length - 1][l] +
-        GetEdgeScore(length, l, 0, variable_log_potentials,
-                     additional_log_potentials);
-      if (best < 0 || val > best_value) {
-        best_value = val;
-        best = l;
-      }
-    }
-
-    // Path (state sequence) backtracking.
-    vector<int> *sequence = static_cast<vector<int>*>(configuration);
-    assert(sequence->size() == length);
-    (*sequence)[length - 1] = best;
-    for (int i = length - 1; i > 0; --i) {
-      (*sequence)[i - 1] = path[i][(*sequence)[i]];
+    int num_last = num_states_[length - 1];
+    for (int l = 0; l < num_last; ++l) {
+      stop_transitions_[l] = additional_log_potentials[stop_edges_[l]];
     }
+    double best_value;
+    int best;
+    RelaxFromPrevious(num_last, 1, &values_[offset_states_[length - 1]],
+                      &stop_transitions_[0], &best_value, &best);
 
+    Backtrack(best, configuration);
     *value = best_value;
   }
 
@@ -265,6 +310,7 @@ class FactorSequence : public GenericFactor {
     }
 
     num_additionals_ = index;
+    BuildFlatIndex();
   }
 
   virtual size_t GetNumAdditionals() override {
@@ -281,6 +327,21 @@ class FactorSequence : public GenericFactor {
   vector<vector<vector<int> > > index_edges_;
 
   size_t num_additionals_;
+
+  // Flat copies of index_edges_: edges from the start symbol, edges into
+  // each position i > 0 (from offset_transitions_[i]), and edges into the
+  // stop symbol.
+  vector<int> start_edges_;
+  vector<int> flat_edges_;
+  vector<int> offset_transitions_;
+  vector<int> stop_edges_;
+
+  // Viterbi workspaces, reused across calls; values_ and path_ are laid
+  // out like the variables (see offset_states_).
+  vector<double> transitions_;
+  vector<double> stop_transitions_;
+  vector<double> values_;
+  vector<int> path_;
 };
 
 } // namespace sparsemap
@@ -24,6 +24,73 @@ class FactorSequenceAdjacent : public FactorSequence {
         return 2;
     }
 
+    /* Viterbi with two transition scores: moving to an adjacent state,
+     * or anything else (including start and stop). The best
+     * non-adjacent previous state is among the three best ones, so each
+     * position costs O(n_states). */
+    void Maximize(const vector<double> &variable_log_potentials,
+                  const vector<double> &additional_log_potentials,
+                  Configuration &configuration,
+                  double *value) override {
+        int length = num_states_.size();
+        int n = num_states_[0];
+        double adjacent = additional_log_potentials[0];
+        double other = additional_log_potentials[1];
+
+        for (int k = 0; k < n; ++k)
+            values_[k] = variable_log_potentials[k] + other;
+
+        for (int i = 1; i < length; ++i) {
+            const double* prev = &values_[(i - 1) * n];
+
+            int top[3] = { -1, -1, -1 };
+            for (int l = 0; l < n; ++l) {
+                int t = 3;
+                while (t > 0 && (top[t - 1] < 0 || prev[l] > prev[top[t - 1]]))
+                    --t;
+                if (t < 3) {
+                    for (int u = 2; u > t; --u)
+                        top[u] = top[u - 1];
+                    top[t] = l;
+                }
+            }
+
+            for (int k = 0; k < n; ++k) {
+                int best = -1;
+                double best_val = 0;
+                for (int t = 0; t < 3 && top[t] >= 0; ++t) {
+                    int l = top[t];
+                    if (l != k - 1 && l != k + 1) {
+                        best = l;
+                        best_val = prev[l] + other;
+                        break;
+                    }
+                }
+                for (int l : { k - 1, k + 1 }) {
+                    if (l < 0 || l >= n)
+                        continue;
+                    double val = prev[l] + adjacent;
+                    if (best < 0 || val > best_val) {
+                        best = l;
+                        best_val = val;
+                    }
+                }
+                values_[i * n + k] =
+                  best_val + variable_log_potentials[i * n + k];
+                path_[i * n + k] = best;
+            }
+        }
+
+        const double* last = &values_[(length - 1) * n];
+        int best = 0;
+        for (int l = 1; l < n; ++l)
+            if (last[l] > last[best])
+                best = l;
+
+        Backtrack(best, configuration);
+        *value = last[best] + other;
+    }
+
     void Initialize(int length, int n_states) {
         num_states_.assign(length, n_states);
 
@@ -73,6 +140,8 @@ class FactorSequenceAdjacent : public FactorSequence {
             }
         }
 
+        values_.resize(length * n_states);
+        path_.resize(length * n_states);
     }
 };
 
@@ -80,8 +149,86 @@ class FactorSequenceAdjacent : public FactorSequence {
 class FactorSequenceDistance : public FactorSequence {
     public:
 
+    /* range start scores, range stop scores, and 2 * range + 1 jumps */
     virtual size_t GetNumAdditionals() override {
-        return 2 * range_ + 1;
+        return 4 * range_ + 1;
+    }
+
+    /* Viterbi using that jumps of range or more cost the same: the best
+     * such previous state is a running prefix (forward jumps) or suffix
+     * (backward jumps) maximum, and only shorter jumps are scored one by
+     * one, so each position costs O(n_states * range). */
+    void Maximize(const vector<double> &variable_log_potentials,
+                  const vector<double> &additional_log_potentials,
+                  Configuration &configuration,
+                  double *value) override {
+        int length = num_states_.size();
+        int n = num_states_[0];
+        int range = range_;
+        const double* jump = &additional_log_potentials[3 * range];
+
+        for (int k = 0; k < n; ++k)
+            values_[k] = variable_log_potentials[k] +
+                         additional_log_potentials[std::min(range, k + 1) - 1];
+
+        for (int i = 1; i < length; ++i) {
+            const double* prev = &values_[(i - 1) * n];
+
+            // argmax of prev[0..l] and of prev[l..n-1]
+            prefix_[0] = 0;
+            for (int l = 1; l < n; ++l) {
+                int p = prefix_[l - 1];
+                prefix_[l] = prev[l] > prev[p] ? l : p;
+            }
+            suffix_[n - 1] = n - 1;
+            for (int l = n - 2; l >= 0; --l) {
+                int p = suffix_[l + 1];
+                suffix_[l] = prev[l] >= prev[p] ? l : p;
+            }
+
+            for (int k = 0; k < n; ++k) {
+                int best = -1;
+                double best_val = 0;
+                auto consider = [&](int l, double val) {
+                    if (best < 0 || val > best_val) {
+                        best = l;
+                        best_val = val;
+                    }
+                };
+
+                if (k - range >= 0) {
+                    int l = prefix_[k - range];
+                    consider(l, prev[l] + jump[range]);
+                }
+                if (k + range < n) {
+                    int l = suffix_[k + range];
+                    consider(l, prev[l] + jump[-range]);
+                }
+                int lo = std::max(0, k - range + 1);
+                int hi = std::min(n - 1, k + range - 1);
+                for (int l = lo; l <= hi; ++l)
+                    consider(l, prev[l] + jump[k - l]);
+
+                values_[i * n + k] =
+                  best_val + variable_log_potentials[i * n + k];
+                path_[i * n + k] = best;
+            }
+        }
+
+        const double* last = &values_[(length - 1) * n];
+        int best = -1;
+        double best_val = 0;
+        for (int l = 0; l < n; ++l) {
+            double val = last[l] +
+              additional_log_potentials[range + std::min(range, n - l) - 1];
+            if (best < 0 || val > best_val) {
+                best = l;
+                best_val = val;
+            }
+        }
+
+        Backtrack(best, configuration);
+        *value = best_val;
     }
 
     void Initialize(int length, int n_states, int range) {
@@ -135,8 +282,16 @@ class FactorSequenceDistance : public FactorSequence {
                 }
             }
         }
+
+        values_.resize(length * n_states);
+        path_.resize(length * n_states);
+        prefix_.resize(n_states);
+        suffix_.resize(n_states);
     }
 
     size_t range_;
+
+    protected:
+    vector<int> prefix_, suffix_;
 };
 }
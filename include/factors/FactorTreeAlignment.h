@@ -0,0 +1,271 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <vector>
+
+#include <ad3/GenericFactor.h>
+
+using AD3::GenericFactor;
+using AD3::Configuration;
+using std::vector;
+
+
+namespace sparsemap {
+
+    /* Alignment of every hypothesis word to exactly one premise word,
+     * rewarding alignments that follow both dependency trees.
+     *
+     * Variables are the pairs (i, j), premise word i and hypothesis word
+     * j, at index prem_sz * j + i. A configuration holds the premise word
+     * a[j] of every j. For each hypothesis arc (hj -> j), the alignment
+     * (a[j], a[hj]) = (i, p) earns additional potential
+     *   0 (head)  if p is the premise head of i,
+     *   1 (cross) if i is the premise head of p,
+     *   2 (grand) if p is the premise grandparent of i,
+     * the last two only if higher-order. These are the XOR-per-column
+     * graph with head, cross and (gi, hj) grandparent pairs, but all the
+     * interactions are along hypothesis arcs, so the MAP is an exact
+     * bottom-up max-product over the hypothesis tree (or forest). Each arc
+     * takes O(n log n), for O(m n log n) in total. */
+    class FactorTreeAlignment : public GenericFactor {
+
+        protected:
+
+        vector<int>* cfg_cast(Configuration cfg) {
+            return static_cast<vector<int> *>(cfg);
+        }
+
+        /* premise head of i, -1 at the root or beyond */
+        int head(int i) const {
+            return i < 0 ? -1 : prem_heads_[i];
+        }
+
+        bool Related(int i, int p) const {
+            return head(i) == p
+                || (higher_order_ && (head(p) == i || head(head(i)) == p));
+        }
+
+        /* reward for a child aligned to i under a parent aligned to p */
+        double Reward(int i, int p,
+                      const vector<double> &additional_log_potentials) const {
+            double r = 0;
+            if (head(i) == p)
+                r += additional_log_potentials[0];
+            if (higher_order_ && head(p) == i)
+                r += additional_log_potentials[1];
+            if (higher_order_ && head(head(i)) == p)
+                r += additional_log_potentials[2];
+            return r;
+        }
+
+        /* Max-product message from a child with scores child[0..n) to its
+         * parent: msg[p] = max_i child[i] + Reward(i, p), and the argmax
+         * in path[p]. Only the O(n) related (i, p) pairs have a reward;
+         * the best unrelated i is found by walking the children in order
+         * of decreasing score, skipping the few related to p. */
+        void Message(const double *child,
+                     const vector<double> &additional_log_potentials,
+                     double *msg,
+                     int *path) {
+            int n = prem_sz_;
+            for (int i = 0; i < n; ++i)
+                order_[i] = i;
+            std::sort(order_.begin(), order_.end(), [child](int a, int b) {
+                return child[a] > child[b];
+            });
+
+            for (int p = 0; p < n; ++p) {
+                msg[p] = -std::numeric_limits<double>::infinity();
+                path[p] = -1;
+                for (int r = 0; r < n; ++r) {
+                    if (!Related(order_[r], p)) {
+                        msg[p] = child[order_[r]];
+                        path[p] = order_[r];
+                        break;
+                    }
+                }
+            }
+
+            auto relax = [&](int i, int p) {
+                if (i < 0 || p < 0)
+                    return;
+                double val = child[i]
+                           + Reward(i, p, additional_log_potentials);
+                if (val > msg[p]) {
+                    msg[p] = val;
+                    path[p] = i;
+                }
+            };
+            for (int i = 0; i < n; ++i) {
+                relax(i, head(i));
+                if (higher_order_) {
+                    relax(head(i), i);
+                    relax(i, head(head(i)));
+                }
+            }
+        }
+
+        public:
+        FactorTreeAlignment () {}
+        virtual ~FactorTreeAlignment() { ClearActiveSet(); }
+
+        void Evaluate(const vector<double> &variable_log_potentials,
+                      const vector<double> &additional_log_potentials,
+                      const Configuration configuration,
+                      double *value) {
+
+            const vector<int>* a = cfg_cast(configuration);
+            *value = 0;
+            for (int j = 0; j < hypo_sz_; ++j) {
+                *value += variable_log_potentials[prem_sz_ * j + (*a)[j]];
+                int hj = hypo_heads_[j];
+                if (hj >= 0)
+                    *value += Reward((*a)[j], (*a)[hj],
+                                     additional_log_potentials);
+            }
+        }
+
+        void Maximize(const vector<double> &variable_log_potentials,
+                      const vector<double> &additional_log_potentials,
+                      Configuration &configuration,
+                      double *value) {
+
+            int n = prem_sz_;
+            for (int k = 0; k < n * hypo_sz_; ++k)
+                values_[k] = variable_log_potentials[k];
+
+            /* children before parents */
+            for (auto j : post_order_) {
+                int hj = hypo_heads_[j];
+                if (hj < 0)
+                    continue;
+                Message(&values_[n * j], additional_log_potentials,
+                        msg_.data(), &path_[n * j]);
+                for (int p = 0; p < n; ++p)
+                    values_[n * hj + p] += msg_[p];
+            }
+
+            /* best root alignments, then down the backpointers */
+            vector<int>* a = cfg_cast(configuration);
+            a->resize(hypo_sz_);
+            *value = 0;
+            for (auto it = post_order_.rbegin(); it != post_order_.rend();
+                 ++it) {
+                int j = *it, hj = hypo_heads_[j];
+                if (hj >= 0) {
+                    (*a)[j] = path_[n * j + (*a)[hj]];
+                    continue;
+                }
+                const double *root = &values_[n * j];
+                (*a)[j] = std::max_element(root, root + n) - root;
+                *value += root[(*a)[j]];
+            }
+        }
+
+        void UpdateMarginalsFromConfiguration(
+                const Configuration &configuration,
+                double weight,
+                vector<double> *variable_posteriors,
+                vector<double> *additional_posteriors) {
+
+            const vector<int>* a = cfg_cast(configuration);
+            for (int j = 0; j < hypo_sz_; ++j) {
+                int i = (*a)[j];
+                (*variable_posteriors)[prem_sz_ * j + i] += weight;
+                int hj = hypo_heads_[j];
+                if (hj < 0)
+                    continue;
+                int p = (*a)[hj];
+                if (head(i) == p)
+                    (*additional_posteriors)[0] += weight;
+                if (higher_order_ && head(p) == i)
+                    (*additional_posteriors)[1] += weight;
+                if (higher_order_ && head(head(i)) == p)
+                    (*additional_posteriors)[2] += weight;
+            }
+        }
+
+        int CountCommonValues(const Configuration &configuration1,
+                              const Configuration &configuration2) {
+            const vector<int>* a1 = cfg_cast(configuration1);
+            const vector<int>* a2 = cfg_cast(configuration2);
+            int common = 0;
+            for (int j = 0; j < hypo_sz_; ++j)
+                if ((*a1)[j] == (*a2)[j])
+                    common += 1;
+            return common;
+        }
+
+        bool SameConfiguration(const Configuration &configuration1,
+                               const Configuration &configuration2) {
+            return *cfg_cast(configuration1) == *cfg_cast(configuration2);
+        }
+
+        void DeleteConfiguration(Configuration configuration) {
+            delete cfg_cast(configuration);
+        }
+
+        Configuration CreateConfiguration() {
+            vector<int>* config = new vector<int>(hypo_sz_, 0);
+            return static_cast<Configuration>(config);
+        }
+
+        /* Heads as stored in the NLI data: one-based, with 0 the root and
+         * entry 0 for the root itself, so head(i) = heads[1 + i] - 1. */
+        void Initialize(const vector<int>& prem_heads,
+                        const vector<int>& hypo_heads,
+                        bool higher_order = false) {
+            prem_sz_ = prem_heads.size() - 1;
+            hypo_sz_ = hypo_heads.size() - 1;
+            higher_order_ = higher_order;
+
+            prem_heads_.resize(prem_sz_);
+            for (int i = 0; i < prem_sz_; ++i)
+                prem_heads_[i] = prem_heads[1 + i] - 1;
+            hypo_heads_.resize(hypo_sz_);
+            for (int j = 0; j < hypo_sz_; ++j)
+                hypo_heads_[j] = hypo_heads[1 + j] - 1;
+
+            /* post-order of the hypothesis forest */
+            vector<vector<int> > children(hypo_sz_);
+            vector<int> stack;
+            for (int j = 0; j < hypo_sz_; ++j) {
+                if (hypo_heads_[j] >= 0)
+                    children[hypo_heads_[j]].push_back(j);
+                else
+                    stack.push_back(j);
+            }
+            post_order_.clear();
+            while (!stack.empty()) {
+                int j = stack.back();
+                stack.pop_back();
+                post_order_.push_back(j);
+                for (auto c : children[j])
+                    stack.push_back(c);
+            }
+            std::reverse(post_order_.begin(), post_order_.end());
+            assert((int) post_order_.size() == hypo_sz_);
+
+            values_.resize(prem_sz_ * hypo_sz_);
+            path_.resize(prem_sz_ * hypo_sz_);
+            msg_.resize(prem_sz_);
+            order_.resize(prem_sz_);
+        }
+
+        virtual size_t GetNumAdditionals() override {
+            return higher_order_ ? 3 : 1;
+        }
+
+        private:
+        int prem_sz_, hypo_sz_;
+        bool higher_order_ = false;
+        vector<int> prem_heads_, hypo_heads_;
+        vector<int> post_order_;
+
+        /* workspaces reused across calls */
+        vector<double> values_, msg_;
+        vector<int> path_, order_;
+    };
+} // namespace sparsemap
@@ -0,0 +1,264 @@
+#pragma once
+
+// Copyright (c) 2012-2015 Andre Martins
+// All Rights Reserved.
+//
+// This file is part of TurboParser 2.3.
+//
+// TurboParser 2.3 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TurboParser 2.3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TurboParser 2.3.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+ * Dependency tree factor, generic in the MAP decoder. The decoder is a
+ * policy class with a non-virtual
+ *   void Decode(const TreeSkeleton&, const vector<double>& scores,
+ *               vector<int>* heads, double* value);
+ * so the choice between algorithms is made once, by the type, instead of
+ * on every Maximize.
+ */
+
+#include <memory>
+#include <ostream>
+#include <tuple>
+
+#include "DependencyDecoder.h"
+#include "ad3/GenericFactor.h"
+
+namespace AD3 {
+
+// The arcs of a tree factor and their index table, which only depend on
+// the sentence length. Immutable once built, so that factors over many
+// sentences of the same length can share one.
+struct TreeSkeleton {
+  // All arcs h -> m, h != m, m > 0, modifier-major (as adj_to_arcs).
+  explicit TreeSkeleton(int length) : length(length) {
+    for (int m = 1; m < length; ++m)
+      for (int h = 0; h < length; ++h)
+        if (h != m)
+          arcs.push_back(std::make_tuple(h, m));
+    BuildIndex();
+  }
+
+  TreeSkeleton(int length, const vector<std::tuple<int, int>>& arcs)
+    : length(length), arcs(arcs) {
+    BuildIndex();
+  }
+
+  void BuildIndex() {
+    index_arcs.assign(length, vector<int>(length, -1));
+    for (size_t k = 0; k < arcs.size(); ++k) {
+      int h, m;
+      std::tie(h, m) = arcs[k];
+      index_arcs[h][m] = k;
+    }
+  }
+
+  int length;
+  vector<std::tuple<int, int>> arcs;
+  vector<vector<int> > index_arcs;
+};
+
+// Non-projective trees, over all (or nearly all) arcs: dense matrix CLE.
+struct ChuLiuEdmondsDenseDecoder {
+  static const char* Name() { return "ARBORESCENCE"; }
+
+  void Decode(const TreeSkeleton& skeleton, const vector<double>& scores,
+              vector<int>* heads, double* value) {
+    decoder.RunChuLiuEdmondsDense(skeleton.length, skeleton.index_arcs,
+                                  scores, heads, value);
+  }
+
+  DependencyDecoder decoder;
+};
+
+// Non-projective trees over a pruned arc set: CLE on candidate lists.
+struct ChuLiuEdmondsSparseDecoder {
+  static const char* Name() { return "ARBORESCENCE"; }
+
+  void Decode(const TreeSkeleton& skeleton, const vector<double>& scores,
+              vector<int>* heads, double* value) {
+    decoder.RunChuLiuEdmonds(skeleton.length, skeleton.index_arcs, scores,
+                             heads, value);
+  }
+
+  DependencyDecoder decoder;
+};
+
+// Projective trees with a single root attachment: Eisner.
+struct EisnerDecoder {
+  static const char* Name() { return "PROJECTIVE_ARBORESCENCE"; }
+
+  void Decode(const TreeSkeleton& skeleton, const vector<double>& scores,
+              vector<int>* heads, double* value) {
+    decoder.RunEisner(skeleton.length, skeleton.arcs.size(),
+                      skeleton.index_arcs, scores, heads, value);
+  }
+
+  DependencyDecoder decoder;
+};
+
+// Projective trees with a single root attachment, where every word has at
+// most max_valency modifiers: valency-bounded Eisner. Replaces a tree
+// factor plus one BUDGET factor per head.
+struct EisnerValencyDecoder {
+  explicit EisnerValencyDecoder(int max_valency = 1)
+    : max_valency(max_valency) {}
+
+  static const char* Name() { return "ARBORESCENCE_VALENCY"; }
+
+  void Decode(const TreeSkeleton& skeleton, const vector<double>& scores,
+              vector<int>* heads, double* value) {
+    decoder.RunEisnerValency(skeleton.length, skeleton.index_arcs, scores,
+                             max_valency, heads, value);
+  }
+
+  int max_valency;
+  DependencyDecoder decoder;
+};
+
+template <class Decoder>
+class TreeFactor : public GenericFactor {
+public:
+  TreeFactor() {}
+  virtual ~TreeFactor() {
+    ClearActiveSet();
+  }
+
+  // Print as a string.
+  void Print(ostream& stream) {
+    stream << Decoder::Name();
+    Factor::Print(stream);
+    stream << endl;
+  }
+
+  // Find the highest scoring tree.
+  // Note: additional_log_potentials is empty and is ignored.
+  void Maximize(const vector<double> &variable_log_potentials,
+                const vector<double> &additional_log_potentials,
+                Configuration &configuration,
+                double *value) {
+    vector<int>* heads = static_cast<vector<int>*>(configuration);
+
+    if (length_ == 1) {
+      heads->at(0) = -1;
+      *value = 0;
+      return;
+    }
+
+    decoder_.Decode(*skeleton_, variable_log_potentials, heads, value);
+  }
+
+  // Compute the score of a given assignment.
+  // Note: additional_log_potentials is empty and is ignored.
+  void Evaluate(const vector<double> &variable_log_potentials,
+                const vector<double> &additional_log_potentials,
+                const Configuration configuration,
+                double *value) {
+    const vector<int> *heads = static_cast<const vector<int>*>(configuration);
+    const vector<vector<int> >& index_arcs = skeleton_->index_arcs;
+    // Heads belong to {0,1,2,...}
+    *value = 0.0;
+    for (int m = 1; m < heads->size(); ++m) {
+      int h = (*heads)[m];
+      *value += variable_log_potentials[index_arcs[h][m]];
+    }
+  }
+
+  // Given a configuration with a probability (weight),
+  // increment the vectors of variable and additional posteriors.
+  // Note: additional_log_potentials is empty and is ignored.
+  void UpdateMarginalsFromConfiguration(
+    const Configuration &configuration,
+    double weight,
+    vector<double> *variable_posteriors,
+    vector<double> *additional_posteriors) {
+    const vector<int> *heads = static_cast<const vector<int>*>(configuration);
+    const vector<vector<int> >& index_arcs = skeleton_->index_arcs;
+    for (int m = 1; m < heads->size(); ++m) {
+      int h = (*heads)[m];
+      (*variable_posteriors)[index_arcs[h][m]] += weight;
+    }
+  }
+
+  // Count how many common values two configurations have.
+  int CountCommonValues(const Configuration &configuration1,
+                        const Configuration &configuration2) {
+    const vector<int> *heads1 = static_cast<const vector<int>*>(configuration1);
+    const vector<int> *heads2 = static_cast<const vector<int>*>(configuration2);
+    int count = 0;
+    for (int i = 1; i < heads1->size(); ++i) {
+      if ((*heads1)[i] == (*heads2)[i]) {
+        ++count;
+      }
+    }
+    return count;
+  }
+
+  // Check if two configurations are the same.
+  bool SameConfiguration(
+    const Configuration &configuration1,
+    const Configuration &configuration2) {
+    const vector<int> *heads1 = static_cast<const vector<int>*>(configuration1);
+    const vector<int> *heads2 = static_cast<const vector<int>*>(configuration2);
+    for (int i = 1; i < heads1->size(); ++i) {
+      if ((*heads1)[i] != (*heads2)[i]) return false;
+    }
+    return true;
+  }
+
+  // Delete configuration.
+  void DeleteConfiguration(
+    Configuration configuration) {
+    vector<int> *heads = static_cast<vector<int>*>(configuration);
+    delete heads;
+  }
+
+  // Create configuration.
+  Configuration CreateConfiguration() {
+    vector<int>* heads = new vector<int>(length_);
+    return static_cast<Configuration>(heads);
+  }
+
+public:
+  void Initialize(int length, const vector<std::tuple<int, int>>& arcs,
+                  const Decoder& decoder = Decoder()) {
+    Initialize(std::make_shared<TreeSkeleton>(length, arcs), decoder);
+  }
+
+  // Over the arcs of a (possibly shared) skeleton: nothing is rebuilt.
+  void Initialize(std::shared_ptr<const TreeSkeleton> skeleton,
+                  const Decoder& decoder = Decoder()) {
+    length_ = skeleton->length;
+    skeleton_ = std::move(skeleton);
+    decoder_ = decoder;
+  }
+
+  virtual void
+  PrintConfiguration(std::ostream& out, const Configuration y) override {
+    vector<int>* heads = static_cast<vector<int>*>(y);
+    for (auto && h : *heads)
+      out << h << " ";
+  }
+
+protected:
+  int length_; // Sentence length (including root symbol).
+  std::shared_ptr<const TreeSkeleton> skeleton_;
+  Decoder decoder_;
+};
+
+typedef TreeFactor<ChuLiuEdmondsDenseDecoder> FactorTree;
+typedef TreeFactor<ChuLiuEdmondsSparseDecoder> FactorTreeSparse;
+typedef TreeFactor<EisnerDecoder> FactorTreeProjective;
+typedef TreeFactor<EisnerValencyDecoder> FactorTreeValency;
+
+} // namespace AD3
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <dynet/dynet.h>
+#include <dynet/expr.h>
+#include <dynet/nodes-def-macros.h>
+#include <dynet/nodes.h>
+
+#include <vector>
+
+#include "layers/tree-aggregate.h"
+
+namespace dynet {
+
+/* The rest of a GCN layer after its stacked affine map: for
+ * Z = [Z_self; Z_parents; Z_children], 3d x (1 + n),
+ *   relu(dropout(Z_self + Z_parents G + Z_children G', p))
+ * in a single node, G a dense adjacency, one tree (as heads) or a mixture
+ * of trees with weights w. Dropout is inverted, as in dy::dropout; p = 0
+ * turns it off. Only the dropout mask is kept for the backward pass. */
+
+dynet::Expression
+gcn_layer(const dynet::Expression& Z, const dynet::Expression& G, float p);
+
+dynet::Expression
+gcn_layer(const dynet::Expression& Z,
+          const std::vector<unsigned>& heads,
+          float p);
+
+dynet::Expression
+gcn_layer(const dynet::Expression& Z,
+          const std::vector<std::vector<unsigned>>& trees,
+          const dynet::Expression& w,
+          float p);
+
+/* A whole batch at once, its nodes concatenated along the columns of Z:
+ * the adjacency is block-diagonal, tree k spanning the nodes cols[k] ..
+ * cols[k] + trees[k].size(), its root first. Unweighted, or with one
+ * weight per tree in w (several trees may share a block). */
+
+dynet::Expression
+gcn_layer(const dynet::Expression& Z,
+          const std::vector<std::vector<unsigned>>& trees,
+          const std::vector<unsigned>& cols,
+          float p);
+
+dynet::Expression
+gcn_layer(const dynet::Expression& Z,
+          const std::vector<std::vector<unsigned>>& trees,
+          const std::vector<unsigned>& cols,
+          const dynet::Expression& w,
+          float p);
+
+/* args {Z, G} if dense, {Z} over trees, {Z, w} over weighted trees */
+struct GCNLayer : public dynet::Node
+{
+    explicit GCNLayer(const std::initializer_list<dynet::VariableIndex>&,
+                      const std::vector<std::vector<unsigned>>& trees,
+                      const std::vector<unsigned>& cols,
+                      float dropout_p);
+
+    DYNET_NODE_DEFINE_DEV_IMPL()
+    virtual size_t aux_storage_size() const override;
+
+    bool dense() const { return trees.empty(); }
+
+    /* gradient wrt the pre-activation, into dpre */
+    void backward_pre(const Tensor& fx,
+                      const Tensor& dEdf,
+                      std::vector<float>& dpre) const;
+
+    std::vector<TreeCSR> trees;
+    std::vector<unsigned> cols;
+    float dropout_p;
+};
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <dynet/dynet.h>
+#include <dynet/expr.h>
+#include <dynet/nodes-def-macros.h>
+#include <dynet/nodes.h>
+
+namespace dynet {
+
+/* Entropic soft matching of an (n x m) score matrix: the plan
+ * P = diag(exp f) exp(scores / temperature) diag(exp g) after n_iter
+ * log-domain Sinkhorn iterations towards rows summing to min(n, m) / n
+ * and columns summing to min(n, m) / m (doubly stochastic if square).
+ * Columns are balanced last, so their sums are exact. The backward pass
+ * differentiates through the unrolled iterations. CPU only. */
+dynet::Expression
+sinkhorn(const dynet::Expression& scores,
+         unsigned n_iter,
+         float temperature = 1);
+
+struct Sinkhorn : public dynet::Node
+{
+    explicit Sinkhorn(const std::initializer_list<dynet::VariableIndex>&,
+                      unsigned n_iter,
+                      float temperature);
+
+    DYNET_NODE_DEFINE_DEV_IMPL()
+
+    unsigned n_iter;
+    float temperature;
+};
+
+}
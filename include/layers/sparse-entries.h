@@ -0,0 +1,46 @@
+#pragma once
+
+#include <dynet/dynet.h>
+#include <dynet/expr.h>
+#include <dynet/nodes-def-macros.h>
+#include <dynet/nodes.h>
+
+#include <vector>
+
+namespace dynet {
+
+/* Pick the entries of x at the given (column-major) linear indices. */
+dynet::Expression
+gather_entries(const dynet::Expression& x,
+               const std::vector<unsigned>& indices);
+
+/* Place u into a zero tensor of shape d, at the given linear indices.
+ * Inverse of gather_entries. */
+dynet::Expression
+scatter_entries(const dynet::Expression& u,
+                const std::vector<unsigned>& indices,
+                const dynet::Dim& d);
+
+struct GatherEntries : public dynet::Node
+{
+    explicit GatherEntries(const std::initializer_list<dynet::VariableIndex>&,
+                           const std::vector<unsigned>& indices);
+
+    DYNET_NODE_DEFINE_DEV_IMPL()
+
+    std::vector<unsigned> indices;
+};
+
+struct ScatterEntries : public dynet::Node
+{
+    explicit ScatterEntries(const std::initializer_list<dynet::VariableIndex>&,
+                            const std::vector<unsigned>& indices,
+                            const dynet::Dim& d);
+
+    DYNET_NODE_DEFINE_DEV_IMPL()
+
+    std::vector<unsigned> indices;
+    dynet::Dim d;
+};
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <dynet/dynet.h>
+#include <dynet/expr.h>
+#include <dynet/nodes-def-macros.h>
+#include <dynet/nodes.h>
+
+#include <vector>
+
+namespace dynet {
+
+/* Message passing over a fixed tree, without its adjacency matrix G.
+ * Columns of X are nodes, 0 the root; heads[m - 1] is the head of node m.
+ * For X (d x (1 + n)),
+ *   tree_parents(X, heads) = X * G      (every node gets its head's column)
+ *   tree_children(X, heads) = X * G'    (every node sums its children's)
+ * both in O(n d) forward and backward, rather than O(n^2 d). */
+
+dynet::Expression
+tree_parents(const dynet::Expression& X, const std::vector<unsigned>& heads);
+
+dynet::Expression
+tree_children(const dynet::Expression& X, const std::vector<unsigned>& heads);
+
+/* The same over a mixture of k trees with weights w, that is over the
+ * adjacency sum_k w[k] G_k, in O(k n d); w gets a gradient too. */
+
+dynet::Expression
+tree_parents(const dynet::Expression& X,
+             const std::vector<std::vector<unsigned>>& trees,
+             const dynet::Expression& w);
+
+dynet::Expression
+tree_children(const dynet::Expression& X,
+              const std::vector<std::vector<unsigned>>& trees,
+              const dynet::Expression& w);
+
+/* the children of node h are child[offset[h] .. offset[h + 1]) */
+struct TreeCSR
+{
+    explicit TreeCSR(const std::vector<unsigned>& heads);
+
+    /* Kernels over column-major matrices of d rows, with column strides
+     * ldx, ldy (so that they also apply to row blocks), G the adjacency:
+     *   add_parents:  Y += w X G
+     *   add_children: Y += w X G'
+     *   dot_parents:  <A, B G> */
+    void add_parents(unsigned d, float w, const float* X, unsigned ldx,
+                     float* Y, unsigned ldy) const;
+    void add_children(unsigned d, float w, const float* X, unsigned ldx,
+                      float* Y, unsigned ldy) const;
+    float dot_parents(unsigned d, const float* A, unsigned lda,
+                      const float* B, unsigned ldb) const;
+
+    std::vector<unsigned> heads;
+    std::vector<unsigned> offset;
+    std::vector<unsigned> child;
+};
+
+/* over one tree with args {X}, or a mixture with args {X, w} */
+struct TreeParents : public dynet::Node
+{
+    explicit TreeParents(const std::initializer_list<dynet::VariableIndex>&,
+                         const std::vector<std::vector<unsigned>>& trees);
+
+    DYNET_NODE_DEFINE_DEV_IMPL()
+
+    std::vector<TreeCSR> trees;
+};
+
+struct TreeChildren : public dynet::Node
+{
+    explicit TreeChildren(const std::initializer_list<dynet::VariableIndex>&,
+                          const std::vector<std::vector<unsigned>>& trees);
+
+    DYNET_NODE_DEFINE_DEV_IMPL()
+
+    std::vector<TreeCSR> trees;
+};
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <dynet/dynet.h>
+#include <dynet/expr.h>
+#include <dynet/nodes-def-macros.h>
+#include <dynet/nodes.h>
+
+#include <ad3/GenericFactor.h>
+
+#include <vector>
+
+namespace dynet {
+
+/* A SparseMAP solution over trees, kept sparse: the k trees of the active
+ * set, as heads (heads[m - 1] the head of node m), and their weights. The
+ * arc marginals would be sum_k weights[k] G_k. */
+struct TreeMixture
+{
+    std::vector<std::vector<unsigned>> trees;
+    dynet::Expression weights;
+};
+
+/* Solve the SparseMAP QP of a tree factor (declared over the arcs of
+ * index_arcs, its configurations head vectors as in TreeFactor) at arc
+ * scores eta_u. The number of trees is only known once solved, so eta_u
+ * is computed and the QP solved right away, not in the forward pass; the
+ * weights are differentiable wrt eta_u. */
+TreeMixture
+tree_mixture(const dynet::Expression& eta_u,
+             AD3::GenericFactor& factor,
+             const std::vector<std::vector<int>>& index_arcs,
+             int max_iter);
+
+/* The weights p of a solved active set. Inside the active set,
+ *   dp / d eta_u = J M',  J = Q^-1 - Q^-1 1 1' Q^-1 / (1' Q^-1 1),
+ * with M the trees' arc indicators and Q = M' M. */
+struct TreeMixtureWeights : public dynet::Node
+{
+    explicit TreeMixtureWeights(
+      const std::initializer_list<dynet::VariableIndex>&,
+      const std::vector<std::vector<unsigned>>& arcs,
+      const std::vector<float>& p);
+
+    DYNET_NODE_DEFINE_DEV_IMPL()
+
+    /* arc indices of every tree, and its weight */
+    std::vector<std::vector<unsigned>> arcs;
+    std::vector<float> p;
+
+    /* J, k x k, column-major */
+    std::vector<float> jacobian;
+};
+
+}
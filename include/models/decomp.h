@@ -99,6 +99,7 @@ struct DecompAttn : public BaseEmbedModel
                         unsigned n_classes,
                         AttnOpts::Attn attn_type,
                         const dy::SparseMAPOpts& smap_opts,
+                        const MatchOpts& match_opts,
                         float dropout_p,
                         bool update_embed)
       : BaseEmbedModel(pc, vocab_size, embed_dim, update_embed)
@@ -111,11 +112,13 @@ struct DecompAttn : public BaseEmbedModel
         else if (attn_type == AttnOpts::Attn::SPARSEMAX)
             attn = std::make_unique<BiSparsemaxBuilder>();
         else if (attn_type == AttnOpts::Attn::MATCH)
-            attn = std::make_unique<MatchingBuilder>(smap_opts);
+            attn = std::make_unique<MatchingBuilder>(smap_opts, match_opts);
         else if (attn_type == AttnOpts::Attn::XOR_MATCH)
             attn = std::make_unique<XORMatchingBuilder>(smap_opts);
         else if (attn_type == AttnOpts::Attn::NEIGHBOR_MATCH)
             attn = std::make_unique<NeighborMatchingBuilder>(p, smap_opts);
+        else if (attn_type == AttnOpts::Attn::SINKHORN)
+            attn = std::make_unique<SinkhornBuilder>(match_opts);
         else {
             std::cerr << "Unimplemented attention mechanism." << std::endl;
             std::exit(EXIT_FAILURE);
@@ -208,6 +211,7 @@ struct DecompAttn : public BaseEmbedModel
         new_graph(cg);
         std::vector<dy::Expression> out;
 
+        std::vector<dy::Expression> Ps, Hs, scores;
         for (auto& sample : batch) {
             auto enc_prem = embed_sent(cg, sample.prem),
                  enc_hypo = embed_sent(cg, sample.hypo);
@@ -218,10 +222,20 @@ struct DecompAttn : public BaseEmbedModel
             auto WP = attend_input(P);
             auto WH = attend_input(H);
 
-            auto scores = dy::transpose(WP) * WH;
+            Ps.push_back(P);
+            Hs.push_back(H);
+            scores.push_back(dy::transpose(WP) * WH);
+        }
+
+        // attention for the whole batch at once
+        auto attended = attn->apply_batch(scores, batch);
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+            auto& P = Ps[i];
+            auto& H = Hs[i];
 
             dy::Expression U_prem, U_hypo;
-            std::tie(U_prem, U_hypo) = attn->apply(scores, sample);
+            std::tie(U_prem, U_hypo) = attended[i];
 
             auto P_ctx = H * U_hypo;
             auto H_ctx = P * U_prem;
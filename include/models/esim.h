@@ -43,6 +43,7 @@ struct ESIM : public BaseNLI
                   unsigned n_classes,
                   AttnOpts::Attn attn_type,
                   const dy::SparseMAPOpts& smap_opts,
+                  const MatchOpts& match_opts,
                   float dropout_p = .5,
                   unsigned stacks = 1,
                   bool update_embed = true)
@@ -71,12 +72,15 @@ struct ESIM : public BaseNLI
         else if (attn_type == AttnOpts::Attn::HEAD)
             attn = std::make_unique<HeadPreservingBuilder>(p, smap_opts);
         else if (attn_type == AttnOpts::Attn::HEADMATCH)
-            attn =
-              std::make_unique<HeadPreservingMatchingBuilder>(p, smap_opts);
+            attn = std::make_unique<HeadPreservingMatchingBuilder>(
+              p, smap_opts, match_opts);
         else if (attn_type == AttnOpts::Attn::HEADHO)
             attn = std::make_unique<HeadHOBuilder>(p, smap_opts);
         else if (attn_type == AttnOpts::Attn::HEADMATCHHO)
-            attn = std::make_unique<HeadHOMatchingBuilder>(p, smap_opts);
+            attn = std::make_unique<HeadHOMatchingBuilder>(
+              p, smap_opts, match_opts);
+        else if (attn_type == AttnOpts::Attn::SINKHORN)
+            attn = std::make_unique<SinkhornBuilder>(match_opts);
         else {
             std::cerr << "Unimplemented attention mechanism." << std::endl;
             std::exit(EXIT_FAILURE);
@@ -146,6 +150,7 @@ struct ESIM : public BaseNLI
 
         vector<Expression> out;
 
+        vector<Expression> Ps, Hs, scores;
         for (auto&& sample : batch) {
             auto enc_prem = embed_ctx_sent(cg, sample.prem),
                  enc_hypo = embed_ctx_sent(cg, sample.hypo);
@@ -154,10 +159,20 @@ struct ESIM : public BaseNLI
             std::tie(P, H) = syntactic_encode(sample, enc_prem, enc_hypo);
 
             // M is prem.size * hypo.size
-            auto scores = transpose(P) * H;
+            scores.push_back(transpose(P) * H);
+            Ps.push_back(P);
+            Hs.push_back(H);
+        }
+
+        // attention for the whole batch at once
+        auto attended = attn->apply_batch(scores, batch);
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+            auto P = Ps[i];
+            auto H = Hs[i];
 
             Expression U_prem, U_hypo;
-            std::tie(U_prem, U_hypo) = attn->apply(scores, sample);
+            std::tie(U_prem, U_hypo) = attended[i];
 
             // get attention-weighted context representations of other side
             auto P_ctx = H * U_hypo;
@@ -2,11 +2,16 @@
 
 #include <dynet/index-tensor.h>
 #include <dynet/tensor.h>
+#include <cmath>
+#include <limits>
 #include <vector>
 
 #include <ad3/FactorGraph.h>
 
+#include "factors/FactorArena.h"
+#include "factors/FactorLabelTree.h"
 #include "models/basemodel.h"
+#include "potentials.h"
 #include "sparsemap.h"
 
 /*
@@ -15,6 +20,65 @@
 
 namespace dy = dynet;
 
+/* Chow-Liu tree of the labels: maximum spanning tree of the mutual
+ * information between label indicators in the data, grown from label 0.
+ * Returns the parent of every label, -1 for the root. */
+inline std::vector<int>
+chow_liu_tree(const std::vector<MLBatch>& data, unsigned n_labels)
+{
+    std::vector<double> count(n_labels, 0), joint(n_labels * n_labels, 0);
+    double n = 0;
+    for (auto& batch : data) {
+        for (auto& instance : batch) {
+            n += 1;
+            for (auto i : instance.labels) {
+                count[i] += 1;
+                for (auto j : instance.labels)
+                    joint[n_labels * i + j] += 1;
+            }
+        }
+    }
+
+    auto plogp = [n](double c, double a, double b) {
+        return c > 0 ? (c / n) * std::log(c * n / (a * b)) : 0.0;
+    };
+    auto mutual_info = [&](unsigned i, unsigned j) {
+        double n11 = joint[n_labels * i + j];
+        double n10 = count[i] - n11, n01 = count[j] - n11;
+        double n00 = n - n11 - n10 - n01;
+        return plogp(n11, count[i], count[j])
+               + plogp(n10, count[i], n - count[j])
+               + plogp(n01, n - count[i], count[j])
+               + plogp(n00, n - count[i], n - count[j]);
+    };
+
+    // Prim's algorithm on the dense graph, O(n_labels^2)
+    std::vector<int> parents(n_labels, -1);
+    std::vector<bool> in_tree(n_labels, false);
+    std::vector<double> best(n_labels,
+                             -std::numeric_limits<double>::infinity());
+    unsigned next = 0;
+    for (unsigned k = 0; k < n_labels; ++k) {
+        unsigned u = next;
+        in_tree[u] = true;
+        double next_mi = -std::numeric_limits<double>::infinity();
+        for (unsigned v = 0; v < n_labels; ++v) {
+            if (in_tree[v])
+                continue;
+            double mi = mutual_info(u, v);
+            if (mi > best[v]) {
+                best[v] = mi;
+                parents[v] = u;
+            }
+            if (best[v] > next_mi) {
+                next_mi = best[v];
+                next = v;
+            }
+        }
+    }
+    return parents;
+}
+
 struct MultiLabelParams
 {
     MultiLabelParams(dy::ParameterCollection& pc,
@@ -141,6 +205,70 @@ struct MultiLabel : public BaseEmbedModel
     unsigned n_labels;
 };
 
+/* The factor graph of StructuredMultiLabel: a binary variable per label
+ * and a PAIR factor per label pair, or a single label tree factor. Its
+ * structure is the same for every instance, so it is built once and
+ * decode only overwrites the potentials. */
+struct LabelGraph
+{
+    LabelGraph(unsigned n_labels,
+               const std::vector<std::pair<unsigned, unsigned>>& label_pairs,
+               const std::vector<int>& label_parents,
+               const dy::SparseMAPOpts& sm_opts)
+      : fg{ std::make_unique<AD3::FactorGraph>() }
+    {
+        fg->SetMaxIterationsAD3(sm_opts.max_iter);
+        fg->SetEtaAD3(sm_opts.eta);
+        fg->AdaptEtaAD3(sm_opts.adapt_eta);
+        fg->SetResidualThresholdAD3(sm_opts.residual_thr);
+
+        vars.resize(n_labels);
+        for (auto& var : vars)
+            var = fg->CreateBinaryVariable();
+
+        if (label_parents.empty()) {
+            for (auto& ij : label_pairs) {
+                auto pair = arena.declare<AD3::FactorPAIR>(
+                  fg.get(), { vars.at(ij.first), vars.at(ij.second) });
+                pairs.push_back(pair);
+            }
+        } else {
+            // a single tree factor: exact, and linear in n_labels
+            tree = arena.declare<sparsemap::FactorLabelTree>(fg.get(), vars);
+            tree->Initialize(label_parents);
+        }
+        eta_v.resize(label_pairs.size());
+    }
+
+    /* push eta_v to the factors; it is shared by a whole batch */
+    void set_pair_potentials()
+    {
+        if (tree) {
+            tree->SetAdditionalLogPotentials(eta_v);
+            return;
+        }
+        // copied into the factor's same-sized buffer: no allocation
+        for (size_t k = 0; k < pairs.size(); ++k) {
+            pair_eta[0] = eta_v[k];
+            pairs[k]->SetAdditionalLogPotentials(pair_eta);
+        }
+    }
+
+    /* factors live in the arena; declared first, destroyed last */
+    sparsemap::FactorArena arena;
+    std::unique_ptr<AD3::FactorGraph> fg;
+    std::vector<AD3::BinaryVariable*> vars;
+    std::vector<AD3::Factor*> pairs;
+    sparsemap::FactorLabelTree* tree = nullptr;
+
+    /* potentials and marginals, reused across instances */
+    std::vector<double> eta_v, mu_u, mu_v;
+    std::vector<double> pair_eta = std::vector<double>(1);
+
+    /* float storage of the inputs of the current computation graph */
+    InputBuffers inputs;
+};
+
 struct StructuredMultiLabel : public MultiLabel
 {
     explicit StructuredMultiLabel(dy::ParameterCollection& pc,
@@ -149,95 +277,151 @@ struct StructuredMultiLabel : public MultiLabel
                                   unsigned n_labels,
                                   float dropout_p,
                                   bool sparsemap,
-                                  const dy::SparseMAPOpts& sm_opts)
+                                  const dy::SparseMAPOpts& sm_opts,
+                                  const std::vector<int>& label_parents = {},
+                                  unsigned corr_rank = 0)
       : MultiLabel{ pc, vocab_size, hidden_dim, n_labels, dropout_p }
-      , p_corr{ p.add_parameters({ (n_labels * (n_labels - 1)) / 2 },
-                                 0,
-                                 "label-corr") }
       , sparsemap{ sparsemap }
       , sm_opts{ sm_opts }
-    {}
-
-    // std::tuple<dy::Expression, dy::Expression>
-
-    std::tuple<std::vector<float>, std::vector<float>> decode(
-      std::vector<float> eta_uf,
-      std::vector<float> eta_vf,
-      const std::vector<int> y_true,
-      bool margin,
-      bool qp)
+      , label_parents{ label_parents }
+      , corr_rank{ corr_rank }
     {
-        auto fg = std::make_unique<AD3::FactorGraph>();
-        fg->SetMaxIterationsAD3(sm_opts.max_iter);
-        fg->SetEtaAD3(sm_opts.eta);
-        fg->AdaptEtaAD3(sm_opts.adapt_eta);
-        fg->SetResidualThresholdAD3(sm_opts.residual_thr);
+        // every pair of labels, or only the edges of the label tree (in
+        // the edge order of FactorLabelTree)
+        if (label_parents.empty()) {
+            for (auto i = 0u; i < n_labels; ++i)
+                for (auto j = i + 1; j < n_labels; ++j)
+                    label_pairs.emplace_back(i, j);
+        } else {
+            for (auto l = 0u; l < n_labels; ++l)
+                if (label_parents[l] >= 0)
+                    label_pairs.emplace_back(label_parents[l], l);
+        }
 
-        auto vars = std::vector<AD3::BinaryVariable*>{ n_labels };
-        auto eta_u = std::vector<double>(eta_uf.begin(), eta_uf.end());
-        auto eta_v = std::vector<double>(eta_vf.begin(), eta_vf.end());
+        // low rank: the potential of (i, j) is <U_i, U_j>, with U
+        // initialized away from zero, where its gradient would vanish
+        if (corr_rank > 0)
+            p_corr_factors =
+              p.add_lookup_parameters(n_labels,
+                                      { corr_rank },
+                                      dy::ParameterInitNormal(0, .01),
+                                      "label-corr-factors");
+        else
+            p_corr = p.add_parameters(
+              { static_cast<unsigned>(label_pairs.size()) }, 0, "label-corr");
+    }
 
-        if (margin) {
-            /* cost-augment */
-            for (auto&& x : eta_u)
-                x += 1.0f;
-            for (auto i : y_true)
-                eta_u.at(i) -= 1.0f;
+    /* potentials of the label pairs, in label_pairs order, into out.
+     * Full rank, the values of eta_v; low rank, computed from the
+     * n_labels rows of U only for these pairs. */
+    void pair_potentials(dy::ComputationGraph& cg,
+                         const dy::Expression& eta_v,
+                         std::vector<double>& out)
+    {
+        if (corr_rank == 0) {
+            to_double(eta_v.value(), out);
+            return;
         }
 
-        std::vector<double> mu_u(eta_u.size());
-        std::vector<double> mu_v(eta_v.size());
+        auto U = dy::const_parameter(cg, p_corr_factors);
+        FloatView U_data = cg.incremental_forward(U);
+
+        out.resize(label_pairs.size());
+        for (size_t k = 0; k < label_pairs.size(); ++k) {
+            auto ui = U_data.begin() + corr_rank * label_pairs[k].first;
+            auto uj = U_data.begin() + corr_rank * label_pairs[k].second;
+            double w = 0;
+            for (auto r = 0u; r < corr_rank; ++r)
+                w += ui[r] * uj[r];
+            out[k] = w;
+        }
+    }
 
-        for (auto i = 0u; i < n_labels; ++i) {
-            vars.at(i) = fg->CreateBinaryVariable();
-            vars.at(i)->SetLogPotential(eta_u.at(i));
+    /* <d, eta_v> over the label pairs, d living as long as the graph.
+     * Low rank, only the pairs with d != 0 are looked up, and the
+     * gradient reaches only their rows. */
+    dy::Expression pair_score(dy::ComputationGraph& cg,
+                              const dy::Expression& eta_v,
+                              const std::vector<float>& d)
+    {
+        if (corr_rank == 0)
+            return dy::dot_product(
+              dy::input(cg, { static_cast<unsigned>(d.size()) }, &d), eta_v);
+
+        std::vector<unsigned> left, right;
+        std::vector<float> weight;
+        for (size_t k = 0; k < d.size(); ++k) {
+            if (d[k] == 0)
+                continue;
+            left.push_back(label_pairs[k].first);
+            right.push_back(label_pairs[k].second);
+            weight.push_back(d[k]);
         }
+        if (weight.empty())
+            return dy::zeros(cg, { 1 });
+
+        auto U_left = dy::lookup(cg, p_corr_factors, left);
+        auto U_right = dy::lookup(cg, p_corr_factors, right);
+        auto w = dy::input(
+          cg, dy::Dim({ 1 }, static_cast<unsigned>(weight.size())), weight);
+        return dy::sum_batches(
+          dy::cmult(dy::dot_product(U_left, U_right), w));
+    }
+
+    /* the factor graph of decode over this model's labels, built on
+     * first use and reused for every instance (decoding is sequential) */
+    LabelGraph& label_graph()
+    {
+        if (!graph_)
+            graph_ = std::make_unique<LabelGraph>(
+              n_labels, label_pairs, label_parents, sm_opts);
+        return *graph_;
+    }
 
-        auto ix = 0;
+    /* solve for the marginals of one instance into graph.mu_u and
+     * graph.mu_v, the pair potentials being already set */
+    void decode(LabelGraph& graph,
+                FloatView eta_u,
+                const std::vector<int>& y_true,
+                bool margin,
+                bool qp)
+    {
         for (auto i = 0u; i < n_labels; ++i)
-            for (auto j = i + 1; j < n_labels; ++j)
-                fg->CreateFactorPAIR({ vars.at(i), vars.at(j) },
-                                     eta_v.at(ix++));
+            graph.vars[i]->SetLogPotential(eta_u[i] + (margin ? 1 : 0));
+        if (margin) {
+            /* cost-augment */
+            for (auto i : y_true)
+                graph.vars.at(i)->SetLogPotential(eta_u[i]);
+        }
 
         double val;
-        // fg->SetVerbosity(100);
+        // graph.fg->SetVerbosity(100);
         if (qp) {
-            fg->SolveQP(&mu_u, &mu_v, &val);
+            graph.fg->SolveQP(&graph.mu_u, &graph.mu_v, &val);
         } else {
-            fg->SolveLPMAPWithAD3(&mu_u, &mu_v, &val);
+            graph.fg->SolveLPMAPWithAD3(&graph.mu_u, &graph.mu_v, &val);
         }
-
-        auto mu_uf = std::vector<float>(mu_u.begin(), mu_u.end());
-        auto mu_vf = std::vector<float>(mu_v.begin(), mu_v.end());
-
-        /*
-        for (auto x : mu_uf)
-            std::cout << x << " ";
-        std::cout << std::endl;
-        for (auto x : mu_vf)
-            std::cout << x << " ";
-        std::cout << std::endl;
-        */
-
-        return std::tie(mu_uf, mu_vf);
     }
 
     virtual std::vector<std::vector<float>> predict(dy::ComputationGraph& cg,
                                                     const MLBatch& batch)
     {
         auto pred = std::vector<std::vector<float>>{};
-        auto eta_v = dy::parameter(cg, p_corr);
+        dy::Expression eta_v;
+        if (corr_rank == 0)
+            eta_v = dy::parameter(cg, p_corr);
         auto out = dy::concatenate_to_batch(forward(cg, batch));
         cg.incremental_forward(out);
-        auto eta_vf = dy::as_vector(eta_v.value());
+
+        auto& graph = label_graph();
+        pair_potentials(cg, eta_v, graph.eta_v);
+        graph.set_pair_potentials();
 
         auto all_scores = out.value();
         for (auto i = 0u; i < batch.size(); ++i) {
-            auto y = batch[i].labels;
-            std::vector<float> mu_u, mu_v;
-            auto eta_uf = dy::as_vector(all_scores.batch_elem(i));
-            std::tie(mu_u, mu_v) = decode(eta_uf, eta_vf, y, false, false);
-            pred.push_back(mu_u);
+            decode(graph, all_scores.batch_elem(i), batch[i].labels, false,
+                   false);
+            pred.emplace_back(graph.mu_u.begin(), graph.mu_u.end());
         }
         return pred;
     }
@@ -247,50 +431,49 @@ struct StructuredMultiLabel : public MultiLabel
     {
         set_train_time();
 
-        auto eta_v = dy::parameter(cg, p_corr);
+        dy::Expression eta_v;
+        if (corr_rank == 0)
+            eta_v = dy::parameter(cg, p_corr);
         auto out = forward(cg, batch);
 
         cg.incremental_forward(out.at(out.size() - 1));
 
-        auto eta_vf = dy::as_vector(eta_v.value());
+        // the previous graph, and the inputs it pointed to, are gone
+        auto& graph = label_graph();
+        graph.inputs.reset();
+        pair_potentials(cg, eta_v, graph.eta_v);
+        graph.set_pair_potentials();
 
         std::vector<dy::Expression> losses;
         for (size_t i = 0; i < batch.size(); ++i) {
             auto y = batch[i].labels;
             auto eta_u = out.at(i);
-            auto eta_uf = dy::as_vector(eta_u.value());
 
             // decode
-            std::vector<float> mu_u_data, mu_v_data;
-            std::tie(mu_u_data, mu_v_data) =
-              decode(eta_uf, eta_vf, y, !sparsemap, sparsemap);
+            decode(graph, eta_u.value(), y, !sparsemap, sparsemap);
 
-            // put into expressions
-            auto mu_u = dy::input(cg, { eta_uf.size() }, mu_u_data);
-            auto mu_v = dy::input(cg, { eta_vf.size() }, mu_v_data);
+            // put into expressions, straight from the solver's buffers
+            auto mu_u = graph.inputs.input(cg, { n_labels }, graph.mu_u);
 
             // build ground truth vector
-            std::vector<float> y_u_data(eta_uf.size(), 0);
-            std::vector<float> y_v_data(eta_vf.size(), 0);
-
+            auto& y_u_data = graph.inputs.floats(n_labels);
             for (auto& ix : y)
                 y_u_data.at(ix) = 1;
+            auto y_u = dy::input(cg, { n_labels }, &y_u_data);
 
+            // mu_v - y_v
+            auto& d_v = graph.inputs.floats(graph.mu_v);
             auto k = 0u;
-            for (auto i = 0u; i < n_labels; ++i) {
-                for (auto j = i + 1; j < n_labels; ++j) {
-                    if ((y_u_data.at(i) > 0.5) && (y_u_data.at(j) > 0.5)) {
-                        y_v_data.at(k) = 1;
-                    }
-                    k += 1;
+            for (auto& ij : label_pairs) {
+                if ((y_u_data.at(ij.first) > 0.5) &&
+                    (y_u_data.at(ij.second) > 0.5)) {
+                    d_v.at(k) -= 1;
                 }
+                k += 1;
             }
 
-            auto y_u = dy::input(cg, { eta_uf.size() }, y_u_data);
-            auto y_v = dy::input(cg, { eta_vf.size() }, y_v_data);
-
             auto loss = dy::dot_product(mu_u - y_u, eta_u) +
-                        dy::dot_product(mu_v - y_v, eta_v);
+                        pair_score(cg, eta_v, d_v);
 
             if (sparsemap) {
                 loss =
@@ -298,10 +481,10 @@ struct StructuredMultiLabel : public MultiLabel
             } else {
                 auto margin_score = .0f;
 
-                for (auto& val : mu_u_data)
+                for (auto& val : graph.mu_u)
                     margin_score += val;
                 for (auto& ix : y)
-                    margin_score -= mu_u_data.at(ix);
+                    margin_score -= graph.mu_u.at(ix);
 
                 loss = loss + margin_score;
             }
@@ -315,5 +498,21 @@ struct StructuredMultiLabel : public MultiLabel
     dy::Parameter p_corr;
     bool sparsemap;
     dy::SparseMAPOpts sm_opts;
+
+    /* label tree (parent of every label), or empty for all pairs */
+    std::vector<int> label_parents;
+
+    /* if nonzero, pair potentials are <U_i, U_j> with U in
+     * p_corr_factors (n_labels rows of this size), instead of p_corr.
+     * Over all label pairs this only saves parameters: the graph, the
+     * potentials and the marginals are still quadratic in n_labels. */
+    unsigned corr_rank;
+    dy::LookupParameter p_corr_factors;
+
+    /* the interacting pairs of labels, one entry of p_corr each */
+    std::vector<std::pair<unsigned, unsigned>> label_pairs;
+
+    /* built by label_graph(), freed with the model */
+    std::unique_ptr<LabelGraph> graph_;
 };
 
@@ -57,7 +57,7 @@ struct GCNSentClf : public BaseEmbedModel
                                            dy::ParameterInitConst(0.0f)) }
         //, gcn{ p, gcn_opts.layers, gcn_opts.iter, hidden_dim }
         , gcn{ p, gcn_opts.layers, hidden_dim, hidden_dim, true }
-        //, gcn_opts_{ gcn_opts }
+        , gcn_opts_{ gcn_opts }
         , hidden_dim_{ hidden_dim }
         , n_classes_{ n_classes }
         , dropout_{ dropout }
@@ -74,10 +74,14 @@ struct GCNSentClf : public BaseEmbedModel
             tree = std::make_unique<CustomAdjacency>();
         else if (tree_type == GCNOpts::Tree::MST)
             tree = std::make_unique<MSTAdjacency>(
-              p, smap_opts, hidden_dim, false, gcn_opts_.budget);
+              p, smap_opts, hidden_dim, false, gcn_opts_.budget,
+              /*projective=*/false, gcn_opts.map_decode,
+              gcn_opts_.mst_window, gcn_opts_.mst_overlap);
         else if (tree_type == GCNOpts::Tree::MST_LSTM)
             tree = std::make_unique<MSTLSTMAdjacency>(
-              p, smap_opts, hidden_dim, dropout_, gcn_opts_.budget);
+              p, smap_opts, hidden_dim, dropout_, gcn_opts_.budget,
+              /*projective=*/false, gcn_opts.map_decode,
+              gcn_opts_.mst_window, gcn_opts_.mst_overlap);
         else {
             std::cerr << "Not implemented";
             std::abort();
@@ -138,6 +142,8 @@ struct GCNSentClf : public BaseEmbedModel
         auto out_W = parameter(cg, p_out_W);
 
         vector<Expression> out;
+        vector<vector<Expression>> ctxs;
+        vector<const Sentence*> sents;
 
         for (auto && sample : batch)
         {
@@ -152,12 +158,20 @@ struct GCNSentClf : public BaseEmbedModel
 
             // root is a vector of all zeros. We have biases.
             ctx.insert(ctx.begin(), dy::zeros(cg, {hidden_dim_}));
+            ctxs.push_back(ctx);
+            sents.push_back(&sample.sentence);
+        }
+
+        auto Gs = tree->make_adj_batch(ctxs, sents);
 
-            auto G = tree->make_adj(ctx, sample.sentence);
-            auto X = dy::concatenate_cols(ctx);
-            auto res = gcn.apply(X, G);
+        vector<Expression> Xs;
+        for (auto&& ctx : ctxs)
+            Xs.push_back(dy::concatenate_cols(ctx));
+        auto res = gcn.apply_batch(Xs, Gs);
 
-            auto h = dy::sum_dim(res, {1});
+        for (auto i = 0u; i < batch.size(); ++i)
+        {
+            auto h = dy::sum_dim(res[i], {1});
 
             // apply simple layer norm
             auto layer_norm_g = parameter(cg, layer_norm_g_p);
@@ -21,12 +21,14 @@ struct SyntacticESIM : public ESIM
                            GCNOpts::Tree tree_type,
                            AttnOpts::Attn attn_type,
                            const dy::SparseMAPOpts& smap_opts,
+                           const MatchOpts& match_opts,
                            float dropout_p = .5,
                            float gcn_dropout_p = .1,
                            unsigned stacks = 1,
                            bool update_embed = true)
-      : ESIM{ params,    vocab_size, embed_dim, hidden_dim, n_classes,
-              attn_type, smap_opts,  dropout_p, stacks,     update_embed }
+      : ESIM{ params,    vocab_size, embed_dim, hidden_dim,
+              n_classes, attn_type,  smap_opts, match_opts,
+              dropout_p, stacks,     update_embed }
       , gcn{ p, 1, gcn_layers, hidden_dim }
       {
         if (tree_type == GCNOpts::Tree::LTR)
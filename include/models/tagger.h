@@ -66,10 +66,14 @@ struct GCNTagger : public BaseEmbedModel
             tree = std::make_unique<CustomAdjacency>();
         else if (tree_type == GCNOpts::Tree::MST)
             tree = std::make_unique<MSTAdjacency>(
-              p, smap_opts, hidden_dim, false, gcn_opts_.budget, gcn_opts_.projective);
+              p, smap_opts, hidden_dim, false, gcn_opts_.budget, gcn_opts_.projective,
+              gcn_opts_.map_decode,
+              gcn_opts_.mst_window, gcn_opts_.mst_overlap);
         else if (tree_type == GCNOpts::Tree::MST_LSTM)
             tree = std::make_unique<MSTLSTMAdjacency>(
-              p, smap_opts, hidden_dim, dropout_, gcn_opts_.budget, gcn_opts_.projective);
+              p, smap_opts, hidden_dim, dropout_, gcn_opts_.budget, gcn_opts_.projective,
+              gcn_opts_.map_decode,
+              gcn_opts_.mst_window, gcn_opts_.mst_overlap);
         else {
             std::cerr << "Not implemented";
             std::abort();
@@ -172,6 +176,8 @@ struct GCNTagger : public BaseEmbedModel
         auto out_W = parameter(cg, p_out_W);
 
         vector<Expression> out;
+        vector<vector<Expression>> ctxs;
+        vector<const Sentence*> sents;
 
         for (auto && sample : batch)
         {
@@ -186,9 +192,21 @@ struct GCNTagger : public BaseEmbedModel
 
             // root is a vector of all zeros. We have biases.
             ctx.insert(ctx.begin(), dy::zeros(cg, {hidden_dim_}));
-            auto G = tree->make_adj(ctx, sample.sentence);
-            auto X = dy::concatenate_cols(ctx);
-            auto H = gcn.apply(X, G);
+            ctxs.push_back(ctx);
+            sents.push_back(&sample.sentence);
+        }
+
+        auto Gs = tree->make_adj_batch(ctxs, sents);
+
+        vector<Expression> Xs;
+        for (auto&& ctx : ctxs)
+            Xs.push_back(dy::concatenate_cols(ctx));
+        auto Hs = gcn.apply_batch(Xs, Gs);
+
+        for (auto i = 0u; i < batch.size(); ++i)
+        {
+            auto && sample = batch[i];
+            auto H = Hs[i];
 
             // drop the root
             H = dy::pick_range(H, 1, sample.size() + 1, 1);
@@ -253,6 +271,8 @@ struct ListopsTagger : public GCNTagger
         auto out_W = parameter(cg, p_out_W);
 
         vector<Expression> out;
+        vector<vector<Expression>> ctxs;
+        vector<const Sentence*> sents;
 
         for (auto && sample : batch)
         {
@@ -268,19 +288,29 @@ struct ListopsTagger : public GCNTagger
             // XXX: this wasn't here before in AISTATS sub
             // root is a vector of all zeros. We have biases.
             ctx.insert(ctx.begin(), dy::zeros(cg, {hidden_dim_}));
+            ctxs.push_back(ctx);
+            sents.push_back(&sample.sentence);
+        }
 
-            // get adj tree from true embeddings (root already included)
-            auto G = tree->make_adj(ctx, sample.sentence);
-
-            // make delexicalized input
+        // get adj trees from true embeddings (root already included)
+        auto Gs = tree->make_adj_batch(ctxs, sents);
 
+        // make delexicalized inputs
+        vector<Expression> Xs;
+        for (auto && sample : batch)
+        {
             auto delex_sentence = sample.sentence;
             delex_sentence.word_ixs = \
                 std::vector<unsigned int>(1 + delex_sentence.size(), DEL_IX);
             auto delex = embed_sent(cg, delex_sentence);
+            Xs.push_back(dy::concatenate_cols(delex));
+        }
+        auto Hs = gcn.apply_batch(Xs, Gs);
 
-            auto X = dy::concatenate_cols(delex);
-            auto H = gcn.apply(X, G);
+        for (auto i = 0u; i < batch.size(); ++i)
+        {
+            auto && sample = batch[i];
+            auto H = Hs[i];
 
             // drop the root
             H = dy::pick_range(H, 1, sample.size() + 1, 1);
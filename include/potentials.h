@@ -0,0 +1,98 @@
+#pragma once
+
+#include <dynet/expr.h>
+#include <dynet/tensor.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+namespace dy = dynet;
+
+/*
+ * Float/double bridge between DyNet and AD3.
+ *
+ * DyNet computes in float, AD3 in double. Potentials are read in place
+ * from tensor memory (this build is CPU only) instead of through
+ * as_vector copies, and solver outputs are converted once, into float
+ * storage that dy::input references by pointer.
+ */
+
+/* read-only view of the floats of a tensor (one batch element) or vector */
+class FloatView
+{
+  public:
+    FloatView(const dy::Tensor& t)
+      : data_{ t.v }
+      , size_{ t.d.size() }
+    {}
+
+    FloatView(const std::vector<float>& v)
+      : data_{ v.data() }
+      , size_{ v.size() }
+    {}
+
+    float operator[](size_t i) const { return data_[i]; }
+    size_t size() const { return size_; }
+    const float* begin() const { return data_; }
+    const float* end() const { return data_ + size_; }
+
+  private:
+    const float* data_;
+    size_t size_;
+};
+
+/* copy the floats of x into the (reused) doubles of out */
+inline void
+to_double(FloatView x, std::vector<double>& out)
+{
+    out.resize(x.size());
+    std::copy(x.begin(), x.end(), out.begin());
+}
+
+/* Float storage for DyNet inputs built from solver outputs. Each input
+ * points into a buffer kept here, so nothing is copied again when the
+ * graph is built; buffers are recycled, keeping their capacity, once
+ * reset() declares the graphs using them gone. */
+class InputBuffers
+{
+  public:
+    /* start a new computation graph */
+    void reset() { used_ = 0; }
+
+    /* a float copy of x, valid until reset() */
+    std::vector<float>& floats(const std::vector<double>& x)
+    {
+        auto& buf = next();
+        buf.assign(x.begin(), x.end());
+        return buf;
+    }
+
+    /* n zeros, valid until reset() */
+    std::vector<float>& floats(size_t n)
+    {
+        auto& buf = next();
+        buf.assign(n, 0);
+        return buf;
+    }
+
+    /* a DyNet input of dimension d over a float copy of x */
+    dy::Expression input(dy::ComputationGraph& cg,
+                         const dy::Dim& d,
+                         const std::vector<double>& x)
+    {
+        return dy::input(cg, d, &floats(x));
+    }
+
+  private:
+    std::vector<float>& next()
+    {
+        if (used_ == buffers_.size())
+            buffers_.emplace_back();
+        return buffers_[used_++];
+    }
+
+    /* a deque, so that handed out buffers never move */
+    std::deque<std::vector<float>> buffers_;
+    size_t used_ = 0;
+};
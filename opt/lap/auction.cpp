@@ -0,0 +1,116 @@
+#include <limits>
+
+#include "lapjv.h"
+#include "lapjv_kernels.h"
+
+/* Forward auction with epsilon-scaling (Bertsekas) for a dense cost
+ * matrix, with the conventions of lapjv: column duals v are the negated
+ * prices of the columns, so row i prefers the column minimizing
+ * c[i][j] - v[j]. The best and second best columns of a bidding row are
+ * found with the two_min kernel of the dense solver.
+ */
+
+/* ratio between the epsilons of consecutive phases */
+#define AUCTION_SCALING 5
+
+
+/** Solve dense LAP with the auction algorithm, to eps_final-optimality.
+ *
+ * Every phase frees all rows and lets them bid, one at a time, until all
+ * are assigned; epsilon then shrinks by AUCTION_SCALING. The final
+ * assignment costs at most n * eps_final more than the optimal one. With
+ * warm == TRUE, v must hold column duals of a similar problem and the
+ * first phases are skipped. On return v holds the final duals.
+ */
+template <typename cost>
+int_t auction_warm(
+    const uint_t n, cost *c[],
+    int_t *x, int_t *y, cost *v,
+    cost eps_final, boolean warm, lapjv_workspace<cost> *ws)
+{
+    const lapjv_kernels<cost> &k = lapjv_get_kernels<cost>();
+
+    if (n == 0) {
+        return 0;
+    }
+    if (n == 1) {
+        x[0] = y[0] = 0;
+        v[0] = c[0][0];
+        return 0;
+    }
+    if (lapjv_workspace_reserve(ws, n) != 0) {
+        return -1;
+    }
+
+    cost lo = c[0][0], hi = c[0][0];
+    for (uint_t i = 0; i < n; i++) {
+        for (uint_t j = 0; j < n; j++) {
+            if (c[i][j] < lo) {
+                lo = c[i][j];
+            } else if (c[i][j] > hi) {
+                hi = c[i][j];
+            }
+        }
+    }
+
+    /* a bid must move the price it raises, or two rows could keep
+     * outbidding each other at no cost */
+    const cost eps_min = 16 * (hi - lo + 1) * std::numeric_limits<cost>::epsilon();
+    if (eps_final < eps_min) {
+        eps_final = eps_min;
+    }
+
+    cost eps;
+    if (warm) {
+        eps = eps_final * AUCTION_SCALING * AUCTION_SCALING;
+    } else {
+        for (uint_t j = 0; j < n; j++) {
+            v[j] = 0;
+        }
+        eps = (hi - lo) / 2;
+    }
+    if (eps < eps_final) {
+        eps = eps_final;
+    }
+
+    int_t *free_rows = ws->free_rows;
+    for (;;) {
+        uint_t n_free = n;
+        for (uint_t i = 0; i < n; i++) {
+            x[i] = -1;
+            y[i] = -1;
+            free_rows[i] = n - 1 - i;
+        }
+        while (n_free > 0) {
+            const int_t i = free_rows[--n_free];
+            cost v1, v2;
+            int_t j1, j2;
+            k.two_min(n, c[i], v, &v1, &j1, &v2, &j2);
+            PRINTF("row %d bids on %d (%f, %f)\n", i, j1, v1, v2);
+            v[j1] -= (v2 - v1) + eps;
+            const int_t i0 = y[j1];
+            x[i] = j1;
+            y[j1] = i;
+            if (i0 >= 0) {
+                x[i0] = -1;
+                free_rows[n_free++] = i0;
+            }
+        }
+        if (eps <= eps_final) {
+            break;
+        }
+        eps /= AUCTION_SCALING;
+        if (eps < eps_final) {
+            eps = eps_final;
+        }
+    }
+    return 0;
+}
+
+
+template int_t auction_warm(const uint_t, double *[], int_t *, int_t *,
+                            double *, double, boolean,
+                            lapjv_workspace<double> *);
+template int_t auction_warm(const uint_t, float *[], int_t *, int_t *,
+                            float *, float, boolean,
+                            lapjv_workspace<float> *);
@@ -3,33 +3,23 @@
 #include <string.h>
 
 #include "lapjv.h"
+#include "lapjv_kernels.h"
 
 /** Column-reduction and reduction transfer for a dense cost matrix.
  */
-int_t _ccrrt_dense(const uint_t n, cost_t *cost[],
-                     int_t *free_rows, int_t *x, int_t *y, cost_t *v)
+template <typename cost>
+int_t _ccrrt_dense(const uint_t n, cost *c[],
+                     int_t *free_rows, int_t *x, int_t *y, cost *v,
+                     boolean *unique, const lapjv_kernels<cost> &k)
 {
     int_t n_free_rows;
-    boolean *unique;
 
     for (uint_t i = 0; i < n; i++) {
         x[i] = -1;
-        v[i] = LARGE;
-        y[i] = 0;
-    }
-    for (uint_t i = 0; i < n; i++) {
-        for (uint_t j = 0; j < n; j++) {
-            const cost_t c = cost[i][j];
-            if (c < v[j]) {
-                v[j] = c;
-                y[j] = i;
-            }
-            PRINTF("i=%d, j=%d, c[i,j]=%f, v[j]=%f y[j]=%d\n", i, j, c, v[j], y[j]);
-        }
     }
+    k.column_min(n, c, v, y);
     PRINT_COST_ARRAY(v, n);
     PRINT_INDEX_ARRAY(y, n);
-    NEW(unique, boolean, n);
     memset(unique, TRUE, n);
     {
         int_t j = n;
@@ -50,31 +40,27 @@ int_t _ccrrt_dense(const uint_t n, cost_t *cost[],
             free_rows[n_free_rows++] = i;
         } else if (unique[i]) {
             const int_t j = x[i];
-            cost_t min = LARGE;
-            for (uint_t j2 = 0; j2 < n; j2++) {
-                if (j2 == (uint_t)j) {
-                    continue;
-                }
-                const cost_t c = cost[i][j2] - v[j2];
-                if (c < min) {
-                    min = c;
-                }
-            }
+            // smallest reduced cost outside of column j
+            cost v1, v2;
+            int_t j1, j2;
+            k.two_min(n, c[i], v, &v1, &j1, &v2, &j2);
+            const cost min = (j1 == j) ? v2 : v1;
             PRINTF("v[%d] = %f - %f\n", j, v[j], min);
             v[j] -= min;
         }
     }
-    FREE(unique);
     return n_free_rows;
 }
 
 
 /** Augmenting row reduction for a dense cost matrix.
  */
+template <typename cost>
 int_t _carr_dense(
-    const uint_t n, cost_t *cost[],
+    const uint_t n, cost *c[],
     const uint_t n_free_rows,
-    int_t *free_rows, int_t *x, int_t *y, cost_t *v)
+    int_t *free_rows, int_t *x, int_t *y, cost *v,
+    const lapjv_kernels<cost> &k)
 {
     uint_t current = 0;
     int_t new_free_rows = 0;
@@ -86,31 +72,13 @@ int_t _carr_dense(
     while (current < n_free_rows) {
         int_t i0;
         int_t j1, j2;
-        cost_t v1, v2, v1_new;
+        cost v1, v2, v1_new;
         boolean v1_lowers;
 
         rr_cnt++;
         PRINTF("current = %d rr_cnt = %d\n", current, rr_cnt);
         const int_t free_i = free_rows[current++];
-        j1 = 0;
-        v1 = cost[free_i][0] - v[0];
-        j2 = -1;
-        v2 = LARGE;
-        for (uint_t j = 1; j < n; j++) {
-            PRINTF("%d = %f %d = %f\n", j1, v1, j2, v2);
-            const cost_t c = cost[free_i][j] - v[j];
-            if (c < v2) {
-                if (c >= v1) {
-                    v2 = c;
-                    j2 = j;
-                } else {
-                    v2 = v1;
-                    v1 = c;
-                    j2 = j1;
-                    j1 = j;
-                }
-            }
-        }
+        k.two_min(n, c[free_i], v, &v1, &j1, &v2, &j2);
         i0 = y[j1];
         v1_new = v[j1] - (v2 - v1);
         v1_lowers = v1_new < v[j1];
@@ -142,59 +110,28 @@ int_t _carr_dense(
 }
 
 
-/** Find columns with minimum d[j] and put them on the SCAN list.
- */
-uint_t _find_dense(const uint_t n, uint_t lo, cost_t *d, int_t *cols, int_t *y)
-{
-    uint_t hi = lo + 1;
-    cost_t mind = d[cols[lo]];
-    for (uint_t k = hi; k < n; k++) {
-        int_t j = cols[k];
-        if (d[j] <= mind) {
-            if (d[j] < mind) {
-                hi = lo;
-                mind = d[j];
-            }
-            cols[k] = cols[hi];
-            cols[hi++] = j;
-        }
-    }
-    return hi;
-}
-
-
 // Scan all columns in TODO starting from arbitrary column in SCAN
 // and try to decrease d of the TODO columns using the SCAN column.
-int_t _scan_dense(const uint_t n, cost_t *cost[],
+template <typename cost>
+int_t _scan_dense(const uint_t n, cost *c[],
                     uint_t *plo, uint_t*phi,
-                    cost_t *d, int_t *cols, int_t *pred,
-                    int_t *y, cost_t *v)
+                    cost *d, int_t *cols, int_t *pred,
+                    int_t *y, cost *v, const lapjv_kernels<cost> &k)
 {
     uint_t lo = *plo;
     uint_t hi = *phi;
-    cost_t h, cred_ij;
+    cost h;
 
     while (lo != hi) {
         int_t j = cols[lo++];
         const int_t i = y[j];
-        const cost_t mind = d[j];
-        h = cost[i][j] - v[j] - mind;
+        const cost mind = d[j];
+        h = c[i][j] - v[j] - mind;
         PRINTF("i=%d j=%d h=%f\n", i, j, h);
         // For all columns in TODO
-        for (uint_t k = hi; k < n; k++) {
-            j = cols[k];
-            cred_ij = cost[i][j] - v[j] - h;
-            if (cred_ij < d[j]) {
-                d[j] = cred_ij;
-                pred[j] = i;
-                if (cred_ij == mind) {
-                    if (y[j] < 0) {
-                        return j;
-                    }
-                    cols[k] = cols[hi];
-                    cols[hi++] = j;
-                }
-            }
+        j = k.scan(n, c[i], i, h, mind, &hi, d, cols, pred, y, v);
+        if (j >= 0) {
+            return j;
         }
     }
     *plo = lo;
@@ -209,25 +146,22 @@ int_t _scan_dense(const uint_t n, cost_t *cost[],
  *
  * \return The closest free column index.
  */
+template <typename cost>
 int_t find_path_dense(
-    const uint_t n, cost_t *cost[],
+    const uint_t n, cost *c[],
     const int_t start_i,
-    int_t *y, cost_t *v,
-    int_t *pred)
+    int_t *y, cost *v,
+    int_t *pred, int_t *cols, cost *d,
+    const lapjv_kernels<cost> &k)
 {
     uint_t lo = 0, hi = 0;
     int_t final_j = -1;
     uint_t n_ready = 0;
-    int_t *cols;
-    cost_t *d;
-
-    NEW(cols, int_t, n);
-    NEW(d, cost_t, n);
 
     for (uint_t i = 0; i < n; i++) {
         cols[i] = i;
         pred[i] = start_i;
-        d[i] = cost[start_i][i] - v[i];
+        d[i] = c[start_i][i] - v[i];
     }
     PRINT_COST_ARRAY(d, n);
     while (final_j == -1) {
@@ -235,11 +169,11 @@ int_t find_path_dense(
         if (lo == hi) {
             PRINTF("%d..%d -> find\n", lo, hi);
             n_ready = lo;
-            hi = _find_dense(n, lo, d, cols, y);
+            hi = k.find(n, lo, d, cols);
             PRINTF("check %d..%d\n", lo, hi);
             PRINT_INDEX_ARRAY(cols, n);
-            for (uint_t k = lo; k < hi; k++) {
-                const int_t j = cols[k];
+            for (uint_t q = lo; q < hi; q++) {
+                const int_t j = cols[q];
                 if (y[j] < 0) {
                     final_j = j;
                 }
@@ -248,7 +182,7 @@ int_t find_path_dense(
         if (final_j == -1) {
             PRINTF("%d..%d -> scan\n", lo, hi);
             final_j = _scan_dense(
-                    n, cost, &lo, &hi, d, cols, pred, y, v);
+                    n, c, &lo, &hi, d, cols, pred, y, v, k);
             PRINT_COST_ARRAY(d, n);
             PRINT_INDEX_ARRAY(cols, n);
             PRINT_INDEX_ARRAY(pred, n);
@@ -258,37 +192,33 @@ int_t find_path_dense(
     PRINTF("found final_j=%d\n", final_j);
     PRINT_INDEX_ARRAY(cols, n);
     {
-        const cost_t mind = d[cols[lo]];
-        for (uint_t k = 0; k < n_ready; k++) {
-            const int_t j = cols[k];
+        const cost mind = d[cols[lo]];
+        for (uint_t q = 0; q < n_ready; q++) {
+            const int_t j = cols[q];
             v[j] += d[j] - mind;
         }
     }
 
-    FREE(cols);
-    FREE(d);
-
     return final_j;
 }
 
 
 /** Augment for a dense cost matrix.
  */
+template <typename cost>
 int_t _ca_dense(
-    const uint_t n, cost_t *cost[],
+    const uint_t n, cost *c[],
     const uint_t n_free_rows,
-    int_t *free_rows, int_t *x, int_t *y, cost_t *v)
+    int_t *free_rows, int_t *x, int_t *y, cost *v,
+    int_t *pred, int_t *cols, cost *d,
+    const lapjv_kernels<cost> &kernels)
 {
-    int_t *pred;
-
-    NEW(pred, int_t, n);
-
     for (int_t *pfree_i = free_rows; pfree_i < free_rows + n_free_rows; pfree_i++) {
         int_t i = -1, j;
         uint_t k = 0;
 
         PRINTF("looking at free_i=%d\n", *pfree_i);
-        j = find_path_dense(n, cost, *pfree_i, y, v, pred);
+        j = find_path_dense(n, c, *pfree_i, y, v, pred, cols, d, kernels);
         ASSERT(j >= 0);
         ASSERT(j < n);
         while (i != *pfree_i) {
@@ -305,34 +235,134 @@ int_t _ca_dense(
             }
         }
     }
-    FREE(pred);
     return 0;
 }
 
 
-/** Solve dense sparse LAP.
+/** Grow the buffers of a workspace to fit an n x n problem.
  */
+template <typename cost>
+int_t lapjv_workspace_reserve(lapjv_workspace<cost> *ws, const uint_t n)
+{
+    if (ws->n >= n) {
+        return 0;
+    }
+    lapjv_workspace_free(ws);
+    NEW(ws->free_rows, int_t, n);
+    NEW(ws->cols, int_t, n);
+    NEW(ws->pred, int_t, n);
+    NEW(ws->d, cost, n);
+    NEW(ws->unique, boolean, n);
+    ws->n = n;
+    return 0;
+}
 
-int lapjv_internal(
-    const uint_t n, cost_t *cost[],
-    int_t *x, int_t *y)
+
+template <typename cost>
+void lapjv_workspace_free(lapjv_workspace<cost> *ws)
 {
-    int ret;
-    int_t *free_rows;
-    cost_t *v;
+    FREE(ws->free_rows);
+    FREE(ws->cols);
+    FREE(ws->pred);
+    FREE(ws->d);
+    FREE(ws->unique);
+    ws->n = 0;
+}
+
 
-    NEW(free_rows, int_t, n);
-    NEW(v, cost_t, n);
-    ret = _ccrrt_dense(n, cost, free_rows, x, y, v);
+/** Solve dense LAP, reusing buffers and optionally the column duals.
+ *
+ * With warm == FALSE this is lapjv_internal. With warm == TRUE, v must
+ * hold column duals (e.g. from a previous solve on a similar matrix):
+ * column reduction is skipped and all rows start free, so augmenting row
+ * reduction assigns most rows directly when v is close to optimal.
+ * On return v holds the optimal column duals.
+ */
+template <typename cost>
+int_t lapjv_warm(
+    const uint_t n, cost *c[],
+    int_t *x, int_t *y, cost *v,
+    boolean warm, lapjv_workspace<cost> *ws)
+{
+    int_t ret;
+    const lapjv_kernels<cost> &k = lapjv_get_kernels<cost>();
+
+    if (n == 0) {
+        return 0;
+    }
+    if (n == 1) {
+        /* column reduction would leave v[0] around -LARGE, out of
+         * range for a later warm start */
+        x[0] = y[0] = 0;
+        v[0] = c[0][0];
+        return 0;
+    }
+    if (lapjv_workspace_reserve(ws, n) != 0) {
+        return -1;
+    }
+    if (warm) {
+        for (uint_t i = 0; i < n; i++) {
+            x[i] = -1;
+            y[i] = -1;
+            ws->free_rows[i] = i;
+        }
+        ret = n;
+    } else {
+        ret = _ccrrt_dense(n, c, ws->free_rows, x, y, v, ws->unique, k);
+    }
     int i = 0;
     while (ret > 0 && i < 2) {
-        ret = _carr_dense(n, cost, ret, free_rows, x, y, v);
+        ret = _carr_dense(n, c, ret, ws->free_rows, x, y, v, k);
         i++;
     }
     if (ret > 0) {
-        ret = _ca_dense(n, cost, ret, free_rows, x, y, v);
+        ret = _ca_dense(n, c, ret, ws->free_rows, x, y, v,
+                        ws->pred, ws->cols, ws->d, k);
     }
+    return ret;
+}
+
+
+/** Solve dense sparse LAP.
+ */
+template <typename cost>
+int_t _lapjv_internal(
+    const uint_t n, cost *c[],
+    int_t *x, int_t *y)
+{
+    int_t ret;
+    cost *v;
+    lapjv_workspace<cost> ws = { 0, 0, 0, 0, 0, 0 };
+
+    NEW(v, cost, n);
+    ret = lapjv_warm(n, c, x, y, v, FALSE, &ws);
+    lapjv_workspace_free(&ws);
     FREE(v);
-    FREE(free_rows);
     return ret;
 }
+
+
+int_t lapjv_internal(
+    const uint_t n, cost_t *cost[],
+    int_t *x, int_t *y)
+{
+    return _lapjv_internal(n, cost, x, y);
+}
+
+
+int_t lapjv_internal(
+    const uint_t n, float *cost[],
+    int_t *x, int_t *y)
+{
+    return _lapjv_internal(n, cost, x, y);
+}
+
+
+template int_t lapjv_workspace_reserve(lapjv_workspace<double> *, const uint_t);
+template int_t lapjv_workspace_reserve(lapjv_workspace<float> *, const uint_t);
+template void lapjv_workspace_free(lapjv_workspace<double> *);
+template void lapjv_workspace_free(lapjv_workspace<float> *);
+template int_t lapjv_warm(const uint_t, double *[], int_t *, int_t *,
+                          double *, boolean, lapjv_workspace<double> *);
+template int_t lapjv_warm(const uint_t, float *[], int_t *, int_t *,
+                          float *, boolean, lapjv_workspace<float> *);
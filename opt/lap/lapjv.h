@@ -56,10 +56,70 @@ typedef double cost_t;
 typedef char boolean;
 typedef enum fp_t { FP_1 = 1, FP_2 = 2, FP_DYNAMIC = 3 } fp_t;
 
+/** Preallocated buffers for repeated dense solves of size up to n.
+ *
+ * The dense solver is instantiated for double (cost_t) and float costs.
+ */
+template <typename cost>
+struct lapjv_workspace {
+    uint_t n;
+    int_t *free_rows;
+    int_t *cols;
+    int_t *pred;
+    cost *d;
+    boolean *unique;
+};
+
+typedef lapjv_workspace<cost_t> lapjv_workspace_t;
+typedef lapjv_workspace<float> lapjv_workspace_f_t;
+
+template <typename cost>
+int_t lapjv_workspace_reserve(lapjv_workspace<cost> *ws, const uint_t n);
+
+template <typename cost>
+void lapjv_workspace_free(lapjv_workspace<cost> *ws);
+
+template <typename cost>
+int_t lapjv_warm(
+    const uint_t n, cost *c[],
+    int_t *x, int_t *y, cost *v,
+    boolean warm, lapjv_workspace<cost> *ws);
+
+/** Dense problem by epsilon-scaling auction, stopping once the
+ * assignment is within n * eps_final of the optimum. Same arguments and
+ * warm starts as lapjv_warm.
+ */
+template <typename cost>
+int_t auction_warm(
+    const uint_t n, cost *c[],
+    int_t *x, int_t *y, cost *v,
+    cost eps_final, boolean warm, lapjv_workspace<cost> *ws);
+
+/** Solve many independent dense problems of various sizes in parallel,
+ * on a work-stealing pool of threads with per-thread buffers. Problem p
+ * has size n[p] and cost rows c[p]; x[p], y[p] and the duals v[p] are
+ * filled as by lapjv_warm from a cold start. n_threads == 0 uses all
+ * hardware threads.
+ */
+template <typename cost>
+int_t lapjv_batch(
+    const uint_t n_problems, const uint_t *n, cost **c[],
+    int_t *x[], int_t *y[], cost *v[], uint_t n_threads = 0);
+
 extern int_t lapjv_internal(
     const uint_t n, cost_t *cost[],
     int_t *x, int_t *y);
 
+extern int_t lapjv_internal(
+    const uint_t n, float *cost[],
+    int_t *x, int_t *y);
+
+/** Name of the instruction set used by the dense solver ("avx512f",
+ * "avx2" or "none"). Picked at first use from what the CPU supports,
+ * capped by the LAPJV_SIMD environment variable if set.
+ */
+extern const char *lapjv_simd();
+
 extern int_t lapmod_internal(
     const uint_t n, cost_t *cc, uint_t *ii, uint_t *kk,
     int_t *x, int_t *y, fp_t fp_version);
@@ -0,0 +1,73 @@
+/* AVX2 kernels of the dense solver, built with -mavx2 -mfma. */
+
+#include <immintrin.h>
+
+#include "lapjv_simd.h"
+
+namespace {
+
+struct avx2_double {
+    typedef double T;
+    typedef __m256d V;
+    typedef __m256d M;
+    enum { W = 4 };
+    static V load(const T *p) { return _mm256_loadu_pd(p); }
+    static void store(T *p, V x) { _mm256_storeu_pd(p, x); }
+    static V set1(T x) { return _mm256_set1_pd(x); }
+    static V iota() { return _mm256_set_pd(3, 2, 1, 0); }
+    static V add(V a, V b) { return _mm256_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static V min(V a, V b) { return _mm256_min_pd(a, b); }
+    static V max(V a, V b) { return _mm256_max_pd(a, b); }
+    static M lt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static M eq(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+    static V blend(M m, V a, V b) { return _mm256_blendv_pd(a, b, m); }
+    static bool any(M m) { return _mm256_movemask_pd(m) != 0; }
+    static V gather(const T *base, const int_t *idx) {
+        // masked form, which does not read an undefined source
+        return _mm256_mask_i32gather_pd(
+            _mm256_setzero_pd(), base,
+            _mm_loadu_si128((const __m128i *)idx),
+            _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), sizeof(T));
+    }
+};
+
+struct avx2_float {
+    typedef float T;
+    typedef __m256 V;
+    typedef __m256 M;
+    enum { W = 8 };
+    static V load(const T *p) { return _mm256_loadu_ps(p); }
+    static void store(T *p, V x) { _mm256_storeu_ps(p, x); }
+    static V set1(T x) { return _mm256_set1_ps(x); }
+    static V iota() { return _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V min(V a, V b) { return _mm256_min_ps(a, b); }
+    static V max(V a, V b) { return _mm256_max_ps(a, b); }
+    static M lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static M eq(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static V blend(M m, V a, V b) { return _mm256_blendv_ps(a, b, m); }
+    static bool any(M m) { return _mm256_movemask_ps(m) != 0; }
+    static V gather(const T *base, const int_t *idx) {
+        return _mm256_mask_i32gather_ps(
+            _mm256_setzero_ps(), base,
+            _mm256_loadu_si256((const __m256i *)idx),
+            _mm256_castsi256_ps(_mm256_set1_epi32(-1)), sizeof(T));
+    }
+};
+
+} // namespace
+
+
+template <>
+lapjv_kernels<double> lapjv_kernels_avx2()
+{
+    return make_kernels<avx2_double>("avx2");
+}
+
+template <>
+lapjv_kernels<float> lapjv_kernels_avx2()
+{
+    return make_kernels<avx2_float>("avx2");
+}
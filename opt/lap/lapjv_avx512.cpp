@@ -0,0 +1,73 @@
+/* AVX-512 kernels of the dense solver, built with -mavx512f. */
+
+#include <immintrin.h>
+
+#include "lapjv_simd.h"
+
+namespace {
+
+struct avx512_double {
+    typedef double T;
+    typedef __m512d V;
+    typedef __mmask8 M;
+    enum { W = 8 };
+    static V load(const T *p) { return _mm512_loadu_pd(p); }
+    static void store(T *p, V x) { _mm512_storeu_pd(p, x); }
+    static V set1(T x) { return _mm512_set1_pd(x); }
+    static V iota() { return _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0); }
+    static V add(V a, V b) { return _mm512_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+    static V min(V a, V b) { return _mm512_mask_min_pd(a, 0xFF, a, b); }
+    static V max(V a, V b) { return _mm512_mask_max_pd(a, 0xFF, a, b); }
+    static M lt(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    static M eq(V a, V b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+    static V blend(M m, V a, V b) { return _mm512_mask_blend_pd(m, a, b); }
+    static bool any(M m) { return m != 0; }
+    static V gather(const T *base, const int_t *idx) {
+        return _mm512_mask_i32gather_pd(
+            _mm512_setzero_pd(), 0xFF,
+            _mm256_loadu_si256((const __m256i *)idx), base, sizeof(T));
+    }
+};
+
+struct avx512_float {
+    typedef float T;
+    typedef __m512 V;
+    typedef __mmask16 M;
+    enum { W = 16 };
+    static V load(const T *p) { return _mm512_loadu_ps(p); }
+    static void store(T *p, V x) { _mm512_storeu_ps(p, x); }
+    static V set1(T x) { return _mm512_set1_ps(x); }
+    static V iota() {
+        return _mm512_set_ps(15, 14, 13, 12, 11, 10, 9, 8,
+                             7, 6, 5, 4, 3, 2, 1, 0);
+    }
+    static V add(V a, V b) { return _mm512_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static V min(V a, V b) { return _mm512_mask_min_ps(a, 0xFFFF, a, b); }
+    static V max(V a, V b) { return _mm512_mask_max_ps(a, 0xFFFF, a, b); }
+    static M lt(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static M eq(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+    static V blend(M m, V a, V b) { return _mm512_mask_blend_ps(m, a, b); }
+    static bool any(M m) { return m != 0; }
+    static V gather(const T *base, const int_t *idx) {
+        return _mm512_mask_i32gather_ps(
+            _mm512_setzero_ps(), 0xFFFF,
+            _mm512_loadu_si512((const void *)idx), base, sizeof(T));
+    }
+};
+
+} // namespace
+
+
+template <>
+lapjv_kernels<double> lapjv_kernels_avx512()
+{
+    return make_kernels<avx512_double>("avx512f");
+}
+
+template <>
+lapjv_kernels<float> lapjv_kernels_avx512()
+{
+    return make_kernels<avx512_float>("avx512f");
+}
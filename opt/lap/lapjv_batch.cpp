@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "lapjv.h"
+
+/* Many independent dense problems solved on a pool of threads.
+ *
+ * The problems are sorted by size and dealt round-robin to the threads
+ * taking part, each getting a contiguous range of the resulting queue. A
+ * thread solves its own range from the front (largest first); once it is
+ * empty, it steals from the back of the others. A range is a single 64 bit
+ * word (begin, end), so both ends move with a compare-and-swap.
+ */
+
+/* Below this much work per thread (in n^3 units) extra threads cost more
+ * to wake than they save. */
+#define LAPJV_BATCH_MIN_WORK (1 << 15)
+
+namespace {
+
+/** Buffers of the calling thread, kept between batches.
+ */
+template <typename cost>
+struct thread_workspace {
+    lapjv_workspace<cost> ws;
+    thread_workspace() : ws{ 0, 0, 0, 0, 0, 0 } {}
+    ~thread_workspace() { lapjv_workspace_free(&ws); }
+};
+
+
+template <typename cost>
+lapjv_workspace<cost> *local_workspace()
+{
+    static thread_local thread_workspace<cost> tw;
+    return &tw.ws;
+}
+
+
+/** Worker threads, started on first use and parked between batches.
+ * For a batch with n_workers helpers, worker w runs job(w + 1) while the
+ * caller runs job(0).
+ */
+class batch_pool {
+public:
+    static batch_pool &get()
+    {
+        static batch_pool pool;
+        return pool;
+    }
+
+    ~batch_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            stop_ = true;
+        }
+        start_.notify_all();
+        for (auto &t : threads_) {
+            t.join();
+        }
+    }
+
+    void run(const uint_t n_workers, const std::function<void(uint_t)> &job)
+    {
+        std::lock_guard<std::mutex> batch(batch_m_);
+        {
+            std::unique_lock<std::mutex> lock(m_);
+            while (threads_.size() < n_workers) {
+                const uint_t w = threads_.size();
+                threads_.emplace_back(&batch_pool::work, this, w,
+                                      generation_);
+            }
+            job_ = &job;
+            active_ = running_ = n_workers;
+            generation_++;
+        }
+        start_.notify_all();
+        job(0);
+        std::unique_lock<std::mutex> lock(m_);
+        done_.wait(lock, [this] { return running_ == 0; });
+        job_ = 0;
+    }
+
+private:
+    void work(const uint_t w, unsigned long seen)
+    {
+        std::unique_lock<std::mutex> lock(m_);
+        for (;;) {
+            start_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) {
+                return;
+            }
+            seen = generation_;
+            if (w >= active_) {
+                continue;
+            }
+            const std::function<void(uint_t)> *job = job_;
+            lock.unlock();
+            (*job)(w + 1);
+            lock.lock();
+            if (--running_ == 0) {
+                done_.notify_one();
+            }
+        }
+    }
+
+    std::mutex batch_m_;  // one batch at a time
+    std::mutex m_;
+    std::condition_variable start_, done_;
+    std::vector<std::thread> threads_;
+    const std::function<void(uint_t)> *job_ = 0;
+    uint_t active_ = 0;
+    uint_t running_ = 0;
+    unsigned long generation_ = 0;
+    bool stop_ = false;
+};
+
+
+inline uint64_t pack_range(const uint64_t begin, const uint64_t end)
+{
+    return (begin << 32) | end;
+}
+
+
+/** Take the first (front) or last entry of a range, -1 if empty.
+ */
+int_t take(std::atomic<uint64_t> &range, const boolean front)
+{
+    uint64_t cur = range.load();
+    for (;;) {
+        const uint64_t begin = cur >> 32, end = cur & 0xffffffff;
+        if (begin >= end) {
+            return -1;
+        }
+        const uint64_t next = front ? pack_range(begin + 1, end)
+                                    : pack_range(begin, end - 1);
+        if (range.compare_exchange_weak(cur, next)) {
+            return front ? begin : end - 1;
+        }
+    }
+}
+
+} // namespace
+
+
+/** Solve many independent dense LAPs in parallel.
+ *
+ * Problem p has size n[p] and cost rows c[p]. Its solution goes to x[p]
+ * and y[p], and its optimal column duals to v[p], as with lapjv_warm.
+ * With n_threads == 0, use as many threads as the hardware has; fewer are
+ * used for small batches. Returns 0, or -1 if a problem failed.
+ */
+template <typename cost>
+int_t lapjv_batch(
+    const uint_t n_problems, const uint_t *n, cost **c[],
+    int_t *x[], int_t *y[], cost *v[], uint_t n_threads)
+{
+    if (n_problems == 0) {
+        return 0;
+    }
+    if (n_threads == 0) {
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    double work = 0;
+    for (uint_t p = 0; p < n_problems; p++) {
+        work += (double) n[p] * n[p] * n[p];
+    }
+    uint_t n_parts = std::min(n_threads, n_problems);
+    n_parts = std::min<double>(n_parts, 1 + work / LAPJV_BATCH_MIN_WORK);
+
+    std::atomic<int_t> ret(0);
+    auto solve = [&](const uint_t p, lapjv_workspace<cost> *ws) {
+        if (lapjv_warm(n[p], c[p], x[p], y[p], v[p], FALSE, ws) != 0) {
+            ret = -1;
+        }
+    };
+
+    if (n_parts <= 1) {
+        lapjv_workspace<cost> *ws = local_workspace<cost>();
+        for (uint_t p = 0; p < n_problems; p++) {
+            solve(p, ws);
+        }
+        return ret;
+    }
+
+    std::vector<uint_t> order(n_problems);
+    for (uint_t p = 0; p < n_problems; p++) {
+        order[p] = p;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [n](uint_t a, uint_t b) { return n[a] > n[b]; });
+
+    std::vector<uint_t> queue;
+    queue.reserve(n_problems);
+    std::unique_ptr<std::atomic<uint64_t>[]> ranges(
+        new std::atomic<uint64_t>[n_parts]);
+    for (uint_t t = 0; t < n_parts; t++) {
+        const uint64_t begin = queue.size();
+        for (uint_t k = t; k < n_problems; k += n_parts) {
+            queue.push_back(order[k]);
+        }
+        ranges[t] = pack_range(begin, queue.size());
+    }
+
+    std::function<void(uint_t)> job = [&](const uint_t t) {
+        lapjv_workspace<cost> *ws = local_workspace<cost>();
+        int_t k;
+        while ((k = take(ranges[t], TRUE)) >= 0) {
+            solve(queue[k], ws);
+        }
+        for (uint_t s = 1; s < n_parts; s++) {
+            std::atomic<uint64_t> &victim = ranges[(t + s) % n_parts];
+            while ((k = take(victim, FALSE)) >= 0) {
+                solve(queue[k], ws);
+            }
+        }
+    };
+    batch_pool::get().run(n_parts - 1, job);
+    return ret;
+}
+
+
+template int_t lapjv_batch(const uint_t, const uint_t *, double **[],
+                           int_t *[], int_t *[], double *[], uint_t);
+template int_t lapjv_batch(const uint_t, const uint_t *, float **[],
+                           int_t *[], int_t *[], float *[], uint_t);
@@ -0,0 +1,46 @@
+#ifndef LAPJV_KERNELS_H
+#define LAPJV_KERNELS_H
+
+#include "lapjv.h"
+
+/** Inner loops of the dense solver, selected at runtime (lapjv_simd.cpp).
+ */
+template <typename cost>
+struct lapjv_kernels {
+    const char *name;
+
+    /** v[j] = min_i c[i][j], y[j] = the first row attaining it. */
+    void (*column_min)(const uint_t n, cost *c[], cost *v, int_t *y);
+
+    /** Smallest (v1, j1) and second smallest (v2, j2) of c[j] - v[j].
+     * Missing entries are LARGE with index -1. */
+    void (*two_min)(const uint_t n, const cost *c, const cost *v,
+                    cost *v1, int_t *j1, cost *v2, int_t *j2);
+
+    /** Lower d of the TODO columns cols[*phi..n) through row i (cost row c),
+     * moving the columns that reach mind onto the SCAN list. Returns a free
+     * column reached at mind, or -1. */
+    int_t (*scan)(const uint_t n, const cost *c, const int_t i,
+                  const cost h, const cost mind, uint_t *phi,
+                  cost *d, int_t *cols, int_t *pred,
+                  const int_t *y, const cost *v);
+
+    /** Move the columns of cols[lo..n) with minimum d to cols[lo..hi),
+     * returning hi. */
+    uint_t (*find)(const uint_t n, const uint_t lo, const cost *d,
+                   int_t *cols);
+};
+
+/** Kernels selected for this CPU. */
+template <typename cost>
+const lapjv_kernels<cost> &lapjv_get_kernels();
+
+/** Vector kernels, in lapjv_avx2.cpp and lapjv_avx512.cpp which are only
+ * built on x86 (LAPJV_HAVE_AVX2, LAPJV_HAVE_AVX512). */
+template <typename cost>
+lapjv_kernels<cost> lapjv_kernels_avx2();
+
+template <typename cost>
+lapjv_kernels<cost> lapjv_kernels_avx512();
+
+#endif // LAPJV_KERNELS_H
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lapjv.h"
+#include "lapjv_kernels.h"
+#include "lapjv_simd.h"
+
+/* Scalar kernels, the loops of the original implementation, and the
+ * runtime selection of the kernels.
+ */
+
+template <typename cost>
+void column_min_scalar(const uint_t n, cost *c[], cost *v, int_t *y)
+{
+    for (uint_t j = 0; j < n; j++) {
+        v[j] = c[0][j];
+        y[j] = 0;
+    }
+    for (uint_t i = 1; i < n; i++) {
+        for (uint_t j = 0; j < n; j++) {
+            const cost x = c[i][j];
+            if (x < v[j]) {
+                v[j] = x;
+                y[j] = i;
+            }
+        }
+    }
+}
+
+
+template <typename cost>
+void two_min_scalar(const uint_t n, const cost *c, const cost *v,
+                    cost *v1, int_t *j1, cost *v2, int_t *j2)
+{
+    *v1 = *v2 = LARGE;
+    *j1 = *j2 = -1;
+    for (uint_t j = 0; j < n; j++) {
+        push_two_min<cost>(c[j] - v[j], j, v1, j1, v2, j2);
+    }
+}
+
+
+template <typename cost>
+int_t scan_scalar(const uint_t n, const cost *c, const int_t i,
+                  const cost h, const cost mind, uint_t *phi,
+                  cost *d, int_t *cols, int_t *pred,
+                  const int_t *y, const cost *v)
+{
+    for (uint_t k = *phi; k < n; k++) {
+        const int_t j = scan_one(k, c, i, h, mind, phi, d, cols, pred, y, v);
+        if (j >= 0) {
+            return j;
+        }
+    }
+    return -1;
+}
+
+
+template <typename cost>
+uint_t find_scalar(const uint_t n, const uint_t lo, const cost *d,
+                   int_t *cols)
+{
+    uint_t hi = lo + 1;
+    cost mind = d[cols[lo]];
+    for (uint_t k = hi; k < n; k++) {
+        int_t j = cols[k];
+        if (d[j] <= mind) {
+            if (d[j] < mind) {
+                hi = lo;
+                mind = d[j];
+            }
+            cols[k] = cols[hi];
+            cols[hi++] = j;
+        }
+    }
+    return hi;
+}
+
+
+/* Best instruction set built in and supported by the CPU, capped by the
+ * LAPJV_SIMD environment variable. 0: none, 1: avx2, 2: avx512f.
+ */
+static int lapjv_simd_level()
+{
+    int level = 0;
+#if defined(LAPJV_HAVE_AVX2) || defined(LAPJV_HAVE_AVX512)
+    __builtin_cpu_init();
+#endif
+#ifdef LAPJV_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        level = 1;
+    }
+#endif
+#ifdef LAPJV_HAVE_AVX512
+    if (__builtin_cpu_supports("avx512f")) {
+        level = 2;
+    }
+#endif
+    const char *cap = getenv("LAPJV_SIMD");
+    if (cap != 0) {
+        if (strcmp(cap, "none") == 0) {
+            level = 0;
+        } else if (strcmp(cap, "avx2") == 0 && level > 1) {
+            level = 1;
+        }
+    }
+    return level;
+}
+
+
+template <typename cost>
+lapjv_kernels<cost> lapjv_select_kernels()
+{
+    switch (lapjv_simd_level()) {
+#ifdef LAPJV_HAVE_AVX512
+    case 2:
+        return lapjv_kernels_avx512<cost>();
+#endif
+#ifdef LAPJV_HAVE_AVX2
+    case 1:
+        return lapjv_kernels_avx2<cost>();
+#endif
+    default: {
+        lapjv_kernels<cost> k;
+        k.name = "none";
+        k.column_min = column_min_scalar<cost>;
+        k.two_min = two_min_scalar<cost>;
+        k.scan = scan_scalar<cost>;
+        k.find = find_scalar<cost>;
+        return k;
+    }
+    }
+}
+
+
+template <typename cost>
+const lapjv_kernels<cost> &lapjv_get_kernels()
+{
+    static const lapjv_kernels<cost> kernels = lapjv_select_kernels<cost>();
+    return kernels;
+}
+
+
+const char *lapjv_simd()
+{
+    return lapjv_get_kernels<cost_t>().name;
+}
+
+
+template const lapjv_kernels<double> &lapjv_get_kernels();
+template const lapjv_kernels<float> &lapjv_get_kernels();
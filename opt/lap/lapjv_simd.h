@@ -0,0 +1,257 @@
+#ifndef LAPJV_SIMD_H
+#define LAPJV_SIMD_H
+
+#include "lapjv.h"
+#include "lapjv_kernels.h"
+
+namespace {
+
+template <typename cost>
+inline void push_two_min(const cost x, const int_t j,
+                         cost *v1, int_t *j1, cost *v2, int_t *j2)
+{
+    if (x < *v2) {
+        if (x >= *v1) {
+            *v2 = x;
+            *j2 = j;
+        } else {
+            *v2 = *v1;
+            *j2 = *j1;
+            *v1 = x;
+            *j1 = j;
+        }
+    }
+}
+
+
+/* One TODO column of the scan: returns the column if it is free and
+ * reached at mind, -1 otherwise. */
+template <typename cost>
+inline int_t scan_one(const uint_t k, const cost *c, const int_t i,
+                      const cost h, const cost mind, uint_t *hi,
+                      cost *d, int_t *cols, int_t *pred,
+                      const int_t *y, const cost *v)
+{
+    const int_t j = cols[k];
+    const cost cred_ij = c[j] - v[j] - h;
+    if (cred_ij < d[j]) {
+        d[j] = cred_ij;
+        pred[j] = i;
+        if (cred_ij == mind) {
+            if (y[j] < 0) {
+                return j;
+            }
+            cols[k] = cols[*hi];
+            cols[(*hi)++] = j;
+        }
+    }
+    return -1;
+}
+
+
+
+/* Vector kernels, written once over a traits class S giving the vector
+ * type V, the comparison mask M and the width W. Column indices are kept
+ * in floating point lanes (exact below 2^24), so that they can be blended
+ * with the same masks as the costs. Branchy updates (scan, find) are only
+ * done lane by lane for the blocks where some lane needs them; they only
+ * ever swap cols[k] with an earlier position, so the indices loaded for a
+ * block stay valid while it is processed.
+ *
+ * This header is included by one source file per instruction set, each
+ * compiled for it, and everything in it has internal linkage so that no
+ * vector code is shared with the generic build.
+ */
+
+template <class S>
+void column_min_simd(const uint_t n, typename S::T *c[],
+                     typename S::T *v, int_t *y)
+{
+    typedef typename S::T T;
+    typedef typename S::V V;
+    typedef typename S::M M;
+    const uint_t W = S::W;
+
+    uint_t j = 0;
+    for (; j + W <= n; j += W) {
+        V vmin = S::load(c[0] + j);
+        V imin = S::set1(0);
+        for (uint_t i = 1; i < n; i++) {
+            const V x = S::load(c[i] + j);
+            const M lt = S::lt(x, vmin);
+            vmin = S::blend(lt, vmin, x);
+            imin = S::blend(lt, imin, S::set1(i));
+        }
+        T idx[W];
+        S::store(v + j, vmin);
+        S::store(idx, imin);
+        for (uint_t l = 0; l < W; l++) {
+            y[j + l] = (int_t)idx[l];
+        }
+    }
+    for (; j < n; j++) {
+        v[j] = c[0][j];
+        y[j] = 0;
+        for (uint_t i = 1; i < n; i++) {
+            if (c[i][j] < v[j]) {
+                v[j] = c[i][j];
+                y[j] = i;
+            }
+        }
+    }
+}
+
+
+template <class S>
+void two_min_simd(const uint_t n, const typename S::T *c,
+                  const typename S::T *v,
+                  typename S::T *v1, int_t *j1,
+                  typename S::T *v2, int_t *j2)
+{
+    typedef typename S::T T;
+    typedef typename S::V V;
+    typedef typename S::M M;
+    const uint_t W = S::W;
+
+    V a1 = S::set1(LARGE), a2 = S::set1(LARGE);
+    V b1 = S::set1(-1), b2 = S::set1(-1);
+    V jj = S::iota();
+    const V step = S::set1(W);
+
+    uint_t j = 0;
+    for (; j + W <= n; j += W) {
+        const V x = S::sub(S::load(c + j), S::load(v + j));
+        const M lt1 = S::lt(x, a1);
+        const M lt2 = S::lt(x, a2);
+        // below the second: x becomes the second, unless it is also below
+        // the first, which then moves down to second. The values go through
+        // min / max, keeping blends off their dependency chain.
+        b2 = S::blend(lt1, S::blend(lt2, b2, jj), b1);
+        b1 = S::blend(lt1, b1, jj);
+        a2 = S::min(a2, S::max(a1, x));
+        a1 = S::min(a1, x);
+        jj = S::add(jj, step);
+    }
+
+    T lane_v1[W], lane_v2[W], lane_j1[W], lane_j2[W];
+    S::store(lane_v1, a1);
+    S::store(lane_v2, a2);
+    S::store(lane_j1, b1);
+    S::store(lane_j2, b2);
+
+    *v1 = *v2 = LARGE;
+    *j1 = *j2 = -1;
+    for (uint_t l = 0; l < W; l++) {
+        push_two_min<T>(lane_v1[l], (int_t)lane_j1[l], v1, j1, v2, j2);
+        push_two_min<T>(lane_v2[l], (int_t)lane_j2[l], v1, j1, v2, j2);
+    }
+    for (; j < n; j++) {
+        push_two_min<T>(c[j] - v[j], j, v1, j1, v2, j2);
+    }
+}
+
+
+template <class S>
+int_t scan_simd(const uint_t n, const typename S::T *c,
+                const int_t i, const typename S::T h,
+                const typename S::T mind, uint_t *phi,
+                typename S::T *d, int_t *cols, int_t *pred,
+                const int_t *y, const typename S::T *v)
+{
+    typedef typename S::V V;
+    const uint_t W = S::W;
+    const V hv = S::set1(h);
+
+    uint_t k = *phi;
+    for (; k + W <= n; k += W) {
+        const V cred = S::sub(S::sub(S::gather(c, cols + k),
+                                     S::gather(v, cols + k)), hv);
+        if (!S::any(S::lt(cred, S::gather(d, cols + k)))) {
+            continue;
+        }
+        for (uint_t l = k; l < k + W; l++) {
+            const int_t j = scan_one(l, c, i, h, mind, phi,
+                                     d, cols, pred, y, v);
+            if (j >= 0) {
+                return j;
+            }
+        }
+    }
+    for (; k < n; k++) {
+        const int_t j = scan_one(k, c, i, h, mind, phi, d, cols, pred, y, v);
+        if (j >= 0) {
+            return j;
+        }
+    }
+    return -1;
+}
+
+
+template <class S>
+uint_t find_simd(const uint_t n, const uint_t lo,
+                 const typename S::T *d, int_t *cols)
+{
+    typedef typename S::T T;
+    typedef typename S::V V;
+    const uint_t W = S::W;
+
+    // smallest d over the columns left
+    T mind = d[cols[lo]];
+    uint_t k = lo;
+    {
+        V m = S::set1(mind);
+        for (; k + W <= n; k += W) {
+            m = S::min(m, S::gather(d, cols + k));
+        }
+        T lanes[W];
+        S::store(lanes, m);
+        for (uint_t l = 0; l < W; l++) {
+            mind = lanes[l] < mind ? lanes[l] : mind;
+        }
+        for (; k < n; k++) {
+            mind = d[cols[k]] < mind ? d[cols[k]] : mind;
+        }
+    }
+
+    // move the columns reaching it to the front
+    uint_t hi = lo;
+    const V m = S::set1(mind);
+    for (k = lo; k + W <= n; k += W) {
+        if (!S::any(S::eq(S::gather(d, cols + k), m))) {
+            continue;
+        }
+        for (uint_t l = k; l < k + W; l++) {
+            const int_t j = cols[l];
+            if (d[j] == mind) {
+                cols[l] = cols[hi];
+                cols[hi++] = j;
+            }
+        }
+    }
+    for (; k < n; k++) {
+        const int_t j = cols[k];
+        if (d[j] == mind) {
+            cols[k] = cols[hi];
+            cols[hi++] = j;
+        }
+    }
+    return hi;
+}
+
+
+/* Kernel table of a traits class S. */
+template <class S>
+lapjv_kernels<typename S::T> make_kernels(const char *name)
+{
+    lapjv_kernels<typename S::T> k;
+    k.name = name;
+    k.column_min = column_min_simd<S>;
+    k.two_min = two_min_simd<S>;
+    k.scan = scan_simd<S>;
+    k.find = find_simd<S>;
+    return k;
+}
+
+} // namespace
+
+#endif // LAPJV_SIMD_H
@@ -243,6 +243,12 @@ main(int argc, char** argv)
     if (is_sparsemap)
         fn << smap_opts.get_filename();
 
+    MatchOpts match_opts;
+    match_opts.topk = attn_opts.topk;
+    match_opts.auction_eps = attn_opts.auction_eps;
+    match_opts.sinkhorn_iter = attn_opts.sinkhorn_iter;
+    match_opts.sinkhorn_temp = attn_opts.sinkhorn_temp;
+
     auto clf = std::make_unique<DecompAttn>(params,
                                             vocab_size,
                                             EMBED_DIM,
@@ -250,6 +256,7 @@ main(int argc, char** argv)
                                             n_classes,
                                             attn_opts.get_attn(),
                                             smap_opts.sm_opts,
+                                            match_opts,
                                             opts.dropout,
                                             decomp_opts.update_embed);
 
@@ -74,6 +74,12 @@ main(int argc, char** argv)
 
     dy::ParameterCollection params;
 
+    MatchOpts match_opts;
+    match_opts.topk = attn_opts.topk;
+    match_opts.auction_eps = attn_opts.auction_eps;
+    match_opts.sinkhorn_iter = attn_opts.sinkhorn_iter;
+    match_opts.sinkhorn_temp = attn_opts.sinkhorn_temp;
+
     std::unique_ptr<BaseNLI> clf;
 
     if (is_gcn)
@@ -86,6 +92,7 @@ main(int argc, char** argv)
                                               gcn_opts.get_tree(),
                                               attn_opts.get_attn(),
                                               smap_opts.sm_opts,
+                                              match_opts,
                                               esim_opts.dropout,
                                               gcn_opts.dropout,
                                               /* lstm_stacks = */ 1,
@@ -99,6 +106,7 @@ main(int argc, char** argv)
                                      n_classes,
                                      attn_opts.get_attn(),
                                      smap_opts.sm_opts,
+                                     match_opts,
                                      esim_opts.dropout,
                                      /* lstm_stacks = */ 1,
                                      /* update_embed = */ true);
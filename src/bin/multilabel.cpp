@@ -156,6 +156,13 @@ main(int argc, char** argv)
     if (is_sparsemap)
         std::cout << smap_opts << std::endl;
 
+    // over all label pairs, the factor graph and the potentials stay
+    // quadratic in the labels whatever the rank
+    if (is_sparsemap && ml_opts.corr_rank > 0 && !ml_opts.label_tree) {
+        std::cerr << "--corr-rank requires --label-tree." << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
     std::stringstream train_fn, test_fn;
     train_fn << "data/multilabel/" << ml_opts.dataset << ".train.txt";
     test_fn << "data/multilabel/" << ml_opts.dataset << ".test.txt";
@@ -166,6 +173,12 @@ main(int argc, char** argv)
     cout << "vocab_size: " << vocab_size << endl;
     cout << "n_labels: " << n_labels << endl;
 
+    std::vector<int> label_parents;
+    if (is_sparsemap && ml_opts.label_tree)
+        label_parents = chow_liu_tree(
+          read_batches<MultiLabelInstance>(train_fn.str(), opts.batch_size),
+          n_labels);
+
     dy::ParameterCollection params;
     auto clf = std::unique_ptr<MultiLabel>{};
 
@@ -179,7 +192,9 @@ main(int argc, char** argv)
                                                      n_labels,
                                                      opts.dropout,
                                                      false,
-                                                     smap_opts.sm_opts);
+                                                     smap_opts.sm_opts,
+                                                     label_parents,
+                                                     ml_opts.corr_rank);
     } else if (ml_opts.method == "sparsemap") {
         clf = std::make_unique<StructuredMultiLabel>(params,
                                                      vocab_size,
@@ -187,7 +202,9 @@ main(int argc, char** argv)
                                                      n_labels,
                                                      opts.dropout,
                                                      true,
-                                                     smap_opts.sm_opts);
+                                                     smap_opts.sm_opts,
+                                                     label_parents,
+                                                     ml_opts.corr_rank);
     }
 
     /* log mlflow run */
@@ -196,6 +213,8 @@ main(int argc, char** argv)
 
     mlflow.log_parameter("dataset", ml_opts.dataset);
     mlflow.log_parameter("method", ml_opts.method);
+    mlflow.log_parameter("label_tree", std::to_string(ml_opts.label_tree));
+    mlflow.log_parameter("corr_rank", std::to_string(ml_opts.corr_rank));
 
     mlflow.log_parameter("lr", std::to_string(opts.lr));
     mlflow.log_parameter("decay", std::to_string(opts.decay));
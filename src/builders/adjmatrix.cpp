@@ -1,9 +1,13 @@
 #include "builders/adjmatrix.h"
-#include "factors/FactorTreeTurbo.h"
+#include "factors/TreeFactor.h"
 #include "layers/arcs-to-adj.h"
+#include "layers/sparse-entries.h"
+#include "layers/tree-mixture.h"
 
 #include <dynet/devices.h>
 
+#include <algorithm>
+
 
 dy::Expression
 make_fixed_adj(dy::ComputationGraph& cg, const std::vector<unsigned>& heads)
@@ -28,6 +32,43 @@ make_fixed_adj(dy::ComputationGraph& cg, const std::vector<unsigned>& heads)
     return U;
 }
 
+// Tokens [begin, end) of a window, and the tokens [core_begin, core_end)
+// that take their head from it.
+struct MSTWindow
+{
+    unsigned begin, end;
+    unsigned core_begin, core_end;
+};
+
+// Windows of at most `window` tokens over the tokens 1 .. sz - 1, each
+// starting window - overlap after the previous one. Cores partition the
+// tokens, in order.
+std::vector<MSTWindow>
+mst_windows(unsigned sz, unsigned window, unsigned overlap)
+{
+    std::vector<MSTWindow> windows;
+    unsigned stride = window - overlap;
+    for (unsigned begin = 1;; begin += stride) {
+        unsigned end = std::min(sz, begin + window);
+        windows.push_back({ begin, end, begin, end });
+        if (end == sz)
+            break;
+    }
+    for (size_t k = 1; k < windows.size(); ++k) {
+        unsigned mid = (windows[k].begin + windows[k - 1].end) / 2;
+        windows[k - 1].core_end = mid;
+        windows[k].core_begin = mid;
+    }
+    return windows;
+}
+
+// Node l of a window is the root if l == 0, else token begin + l - 1.
+unsigned
+window_node(const MSTWindow& w, unsigned l)
+{
+    return l == 0 ? 0 : w.begin + l - 1;
+}
+
 std::tuple<dy::Expression, dy::Expression>
 TreeAdjacency::make_adj_pair(const std::vector<dy::Expression>& enc_prem,
                              const std::vector<dy::Expression>& enc_hypo,
@@ -39,6 +80,17 @@ TreeAdjacency::make_adj_pair(const std::vector<dy::Expression>& enc_prem,
     return std::forward_as_tuple(Gprem, Ghypo);
 }
 
+std::vector<GCNGraph>
+TreeAdjacency::make_adj_batch(
+  const std::vector<std::vector<dy::Expression>>& inputs,
+  const std::vector<const Sentence*>& sents)
+{
+    std::vector<GCNGraph> out;
+    for (size_t i = 0; i < inputs.size(); ++i)
+        out.push_back(make_adj(inputs[i], *sents[i]));
+    return out;
+}
+
 void
 FixedAdjacency::new_graph(dy::ComputationGraph& cg, bool)
 {
@@ -52,15 +104,32 @@ FixedAdjacency::make_fixed_adj(const std::vector<unsigned>& heads)
 }
 
 dy::Expression
-FlatAdjacency::make_adj(const std::vector<dy::Expression>&,
-                        const Sentence& sent)
+FixedAdjacency::make_adj(const std::vector<dy::Expression>&,
+                         const Sentence& sent)
+{
+    return make_fixed_adj(heads(sent));
+}
+
+std::vector<GCNGraph>
+FixedAdjacency::make_adj_batch(
+  const std::vector<std::vector<dy::Expression>>&,
+  const std::vector<const Sentence*>& sents)
+{
+    std::vector<GCNGraph> out;
+    for (auto sent : sents)
+        out.emplace_back(heads(*sent));
+    return out;
+}
+
+std::vector<unsigned>
+FlatAdjacency::heads(const Sentence& sent)
 {
     size_t n = sent.heads.size() - 1;
-    std::vector<unsigned> nonneg_heads(n, 0);
-    return make_fixed_adj(nonneg_heads);
+    return std::vector<unsigned>(n, 0);
 }
-dy::Expression
-LtrAdjacency::make_adj(const std::vector<dy::Expression>&, const Sentence& sent)
+
+std::vector<unsigned>
+LtrAdjacency::heads(const Sentence& sent)
 {
     size_t n = sent.heads.size() - 1;
     std::vector<unsigned> nonneg_heads;
@@ -70,16 +139,27 @@ LtrAdjacency::make_adj(const std::vector<dy::Expression>&, const Sentence& sent)
         nonneg_heads.push_back(k + 1);
     if (k <= n)
         nonneg_heads.push_back(0);
-    return make_fixed_adj(nonneg_heads);
+    return nonneg_heads;
 }
 
-dy::Expression
-CustomAdjacency::make_adj(const std::vector<dy::Expression>&,
-                          const Sentence& sent)
+std::vector<unsigned>
+CustomAdjacency::heads(const Sentence& sent)
 {
-    std::vector<unsigned> nonneg_heads(sent.heads.begin() + 1,
-                                       sent.heads.end());
-    return make_fixed_adj(nonneg_heads);
+    return std::vector<unsigned>(sent.heads.begin() + 1, sent.heads.end());
+}
+
+// declares a TreeFactor<Decoder>, with a copy of `decoder`, in the arena
+template <class Decoder>
+auto
+tree_declarer(Decoder decoder)
+{
+    return [decoder](sparsemap::FactorArena& arena,
+                     AD3::FactorGraph* fg,
+                     const std::vector<AD3::BinaryVariable*>& vars,
+                     std::shared_ptr<const AD3::TreeSkeleton> skel) {
+        auto tree = arena.declare<AD3::TreeFactor<Decoder>>(fg, vars);
+        tree->Initialize(std::move(skel), decoder);
+    };
 }
 
 MSTAdjacency::MSTAdjacency(dy::ParameterCollection& params,
@@ -87,79 +167,220 @@ MSTAdjacency::MSTAdjacency(dy::ParameterCollection& params,
                            unsigned hidden_dim,
                            bool use_distance,
                            int budget,
-                           bool projective)
+                           bool projective,
+                           bool map_decode,
+                           unsigned window,
+                           unsigned overlap)
   : opts{ opts }
   , scorer{ params, hidden_dim, hidden_dim }
   , distance_bias{ params, use_distance }
   , budget{ budget }
   , projective{ projective }
-{}
+  , map_decode{ map_decode }
+  , window{ std::max(window, 2u) }
+  , overlap{ std::min(overlap, this->window / 2) }
+{
+    // valency limits handled exactly inside a single projective factor;
+    // non-projective budgets are separate factors (see make_tree_graph)
+    if (budget > 0 && projective)
+        declare_tree_ = tree_declarer(AD3::EisnerValencyDecoder{ budget });
+    else if (projective)
+        declare_tree_ = tree_declarer(AD3::EisnerDecoder{});
+    else
+        declare_tree_ = tree_declarer(AD3::ChuLiuEdmondsDenseDecoder{});
+}
 
 void
-MSTAdjacency::new_graph(dy::ComputationGraph& cg, bool)
+MSTAdjacency::new_graph(dy::ComputationGraph& cg, bool training)
 {
     cg_ = &cg;
+    training_ = training;
     scorer.new_graph(cg);
+    arena_.reset();
 }
 
 dy::Expression
-MSTAdjacency::make_adj(const std::vector<dy::Expression>& enc, const Sentence&)
+MSTAdjacency::arc_scores(const std::vector<dy::Expression>& enc)
 {
+    auto scores = scorer.make_potentials(encode(enc));
+    return distance_bias.compute(scores);
+}
 
-    auto fg = std::make_unique<AD3::FactorGraph>();
-    std::vector<AD3::BinaryVariable*> vars;
-    std::vector<std::tuple<int, int>> arcs;
-    unsigned sz = enc.size();
+std::vector<GCNGraph>
+MSTAdjacency::make_adj_batch(
+  const std::vector<std::vector<dy::Expression>>& inputs,
+  const std::vector<const Sentence*>& sents)
+{
+    // the budget constraints need the AD3 graph.
+    if (training_ || !map_decode || budget > 0) {
+        std::vector<GCNGraph> out;
+        for (size_t i = 0; i < inputs.size(); ++i)
+            out.push_back(make_graph(inputs[i], *sents[i]));
+        return out;
+    }
+
+    if (inputs.empty())
+        return {};
 
-    // if (sz > 385) { // 99th percentile: use flat
-    if (sz > 500) { // 99th percentile: use flat
-        std::vector<unsigned> nonneg_heads(sz - 1, 0);
-        return ::make_fixed_adj(*cg_, nonneg_heads);
+    // every window of every sentence is decoded in the same batch; short
+    // sentences are a single window.
+    std::vector<size_t> sent_of;
+    std::vector<MSTWindow> windows;
+    int max_len = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        unsigned sz = inputs[i].size();
+        auto ws = sz - 1 > window ? mst_windows(sz, window, overlap)
+                                  : std::vector<MSTWindow>{ { 1, sz, 1, sz } };
+        for (auto& w : ws) {
+            sent_of.push_back(i);
+            windows.push_back(w);
+            max_len = std::max(max_len, int(1 + w.end - w.begin));
+        }
     }
 
-    unsigned k = 1;
+    decoder.reset(max_len, windows.size());
+    std::vector<float> scores, window_scores;
+    for (size_t k = 0, i = inputs.size(); k < windows.size(); ++k) {
+        if (sent_of[k] != i) {
+            i = sent_of[k];
+            scores = dy::as_vector(arc_scores(inputs[i]).value());
+        }
+        unsigned sz = inputs[i].size();
+        unsigned n = 1 + windows[k].end - windows[k].begin;
+        window_scores.resize(n * n);
+        for (unsigned m = 0; m < n; ++m)
+            for (unsigned h = 0; h < n; ++h)
+                window_scores[m * n + h] =
+                  scores[sz * window_node(windows[k], m)
+                         + window_node(windows[k], h)];
+        decoder.set_scores(k, n, window_scores.data());
+    }
+
+    std::vector<std::vector<int>> heads;
+    std::vector<double> values;
+    if (projective)
+        decoder.run_eisner(&heads, &values);
+    else
+        decoder.run_chu_liu_edmonds(&heads, &values);
+
+    std::vector<std::vector<unsigned>> nonneg_heads(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i)
+        nonneg_heads[i].resize(inputs[i].size() - 1);
+    for (size_t k = 0; k < windows.size(); ++k) {
+        auto& w = windows[k];
+        for (unsigned m = w.core_begin; m < w.core_end; ++m)
+            nonneg_heads[sent_of[k]][m - 1] =
+              window_node(w, heads[k][1 + m - w.begin]);
+    }
+
+    return std::vector<GCNGraph>(nonneg_heads.begin(), nonneg_heads.end());
+}
+
+std::shared_ptr<const AD3::TreeSkeleton>
+MSTAdjacency::skeleton(unsigned sz)
+{
+    auto& cached = skeletons_[sz];
+    if (!cached)
+        cached = std::make_shared<const AD3::TreeSkeleton>(sz);
+    return cached;
+}
+
+std::unique_ptr<AD3::FactorGraph>
+MSTAdjacency::make_tree_graph(unsigned sz)
+{
+    // arcs and index tables are shared across sentences of this length;
+    // only the variables are new.
+    auto skel = skeleton(sz);
+    auto fg = std::make_unique<AD3::FactorGraph>();
+    std::vector<AD3::BinaryVariable*> vars(skel->arcs.size());
+    for (auto& var : vars)
+        var = fg->CreateBinaryVariable();
 
-    std::vector<std::vector<AD3::BinaryVariable*>> kids(sz);
+    declare_tree_(arena_, fg.get(), vars, skel);
 
-    for (size_t m = 1; m < sz; ++m) {
+    if (budget > 0 && !projective) {
+        std::vector<AD3::BinaryVariable*> kids;
         for (size_t h = 0; h < sz; ++h) {
-            if (h != m) {
-                arcs.push_back(std::make_tuple(h, m));
-                auto var = fg->CreateBinaryVariable();
-                vars.push_back(var);
-                kids.at(h).push_back(var);
-                ++k;
-            }
+            kids.clear();
+            for (size_t m = 1; m < sz; ++m)
+                if (h != m)
+                    kids.push_back(vars[skel->index_arcs[h][m]]);
+            fg->CreateFactorBUDGET(kids, budget, /*own=*/true);
         }
     }
+    return fg;
+}
 
-    // Old tree factor
-    // AD3::Factor* tree_factor = new AD3::FactorTree;
-    // fg->DeclareFactor(tree_factor, vars, /*pass_ownership=*/true);
-    // static_cast<AD3::FactorTree*>(tree_factor)->Initialize(sz, arcs);
+GCNGraph
+MSTAdjacency::make_graph(const std::vector<dy::Expression>& enc,
+                         const Sentence& sent)
+{
+    unsigned sz = enc.size();
 
-    AD3::Factor* tree_factor = new AD3::FactorTreeTurbo;
-    fg->DeclareFactor(tree_factor, vars, /*pass_ownership=*/true);
-    static_cast<AD3::FactorTreeTurbo*>(tree_factor)->Initialize(projective, sz, arcs);
+    // budget factors and windows take more than one factor, and printing
+    // goes through dy::sparsemap
+    bool single_factor = budget == 0 || projective;
+    if (!single_factor || sz - 1 > window || opts.log_stream)
+        return make_adj(enc, sent);
 
-    if (budget > 0)
-        for (size_t h = 0; h < sz; ++h)
-            fg->CreateFactorBUDGET(kids.at(h), budget, /*own=*/true);
+    auto* cpu = dy::get_device_manager()->get_global_device("CPU");
+    auto scores_cpu = dy::adj_to_arcs(dy::to_device(arc_scores(enc), cpu));
 
-    auto scores = scorer.make_potentials(enc);
-    scores = distance_bias.compute(scores);
+    auto fg = make_tree_graph(sz);
+    auto* tree = static_cast<AD3::GenericFactor*>(fg->GetFactor(0));
+    auto mixture = dy::tree_mixture(scores_cpu,
+                                    *tree,
+                                    skeleton(sz)->index_arcs,
+                                    opts.max_active_set_iter);
+    return GCNGraph(std::move(mixture.trees), mixture.weights);
+}
+
+dy::Expression
+MSTAdjacency::make_adj(const std::vector<dy::Expression>& enc, const Sentence&)
+{
+    unsigned sz = enc.size();
+    auto scores = arc_scores(enc);
 
     const auto device_name = scores.get_device_name();
     auto* device = dy::get_device_manager()->get_global_device(device_name);
     auto* cpu = dy::get_device_manager()->get_global_device("CPU");
     auto scores_cpu_matrix = dy::to_device(scores, cpu);
-    auto scores_cpu = dy::adj_to_arcs(scores_cpu_matrix);
 
     //fg->SetVerbosity(10);
-    auto u_cpu = dy::sparsemap(scores_cpu, std::move(fg), opts);
-    u_cpu = dy::arcs_to_adj(u_cpu, sz);
-    auto u = dy::to_device(u_cpu, device);
-    return u;
+    dy::Expression u_cpu;
+    if (sz - 1 <= window) {
+        auto scores_cpu = dy::adj_to_arcs(scores_cpu_matrix);
+        u_cpu = dy::sparsemap(scores_cpu, make_tree_graph(sz), opts);
+        u_cpu = dy::arcs_to_adj(u_cpu, sz);
+        return dy::to_device(u_cpu, device);
+    }
+
+    // one tree per window; keep the arcs into its core tokens, which are
+    // contiguous in arc order (modifier-major, as adj_to_arcs).
+    std::vector<dy::Expression> kept;
+    std::vector<unsigned> kept_ixs;
+    for (auto& w : mst_windows(sz, window, overlap)) {
+        unsigned n = 1 + w.end - w.begin;
+        std::vector<unsigned> arc_ixs;
+        for (unsigned m = 1; m < n; ++m)
+            for (unsigned h = 0; h < n; ++h)
+                if (h != m)
+                    arc_ixs.push_back(sz * window_node(w, m)
+                                      + window_node(w, h));
+
+        auto eta_u = dy::gather_entries(scores_cpu_matrix, arc_ixs);
+        auto u = dy::sparsemap(eta_u, make_tree_graph(n), opts);
+
+        unsigned lo = (w.core_begin - w.begin) * (n - 1);
+        unsigned hi = (w.core_end - w.begin) * (n - 1);
+        kept.push_back(dy::pick_range(u, lo, hi));
+        kept_ixs.insert(kept_ixs.end(),
+                        arc_ixs.begin() + lo,
+                        arc_ixs.begin() + hi);
+    }
+
+    u_cpu = dy::scatter_entries(dy::concatenate(kept), kept_ixs, { sz, sz });
+    return dy::to_device(u_cpu, device);
 }
 
 MSTLSTMAdjacency::MSTLSTMAdjacency(dy::ParameterCollection& params,
@@ -167,8 +388,12 @@ MSTLSTMAdjacency::MSTLSTMAdjacency(dy::ParameterCollection& params,
                                    unsigned hidden_dim,
                                    float dropout_p,
                                    int budget,
-                                   bool projective)
-  : MSTAdjacency{ params, opts, hidden_dim, /*dist=*/false, budget, projective}
+                                   bool projective,
+                                   bool map_decode,
+                                   unsigned window,
+                                   unsigned overlap)
+  : MSTAdjacency{ params, opts, hidden_dim, /*dist=*/false, budget, projective,
+                  map_decode, window, overlap }
   , bilstm_settings{ /*stacks=*/1, /*layers=*/1, hidden_dim / 2 }
   , bilstm{ params, bilstm_settings, hidden_dim }
   , dropout_p{ dropout_p }
@@ -185,11 +410,9 @@ MSTLSTMAdjacency::new_graph(dy::ComputationGraph& cg, bool training)
         bilstm.disable_dropout();
 }
 
-dy::Expression
-MSTLSTMAdjacency::make_adj(const std::vector<dy::Expression>& enc,
-                           const Sentence& sentence)
+std::vector<dy::Expression>
+MSTLSTMAdjacency::encode(const std::vector<dy::Expression>& enc)
 {
-    auto bilstm_out = bilstm(enc);
-    return MSTAdjacency::make_adj(bilstm_out, sentence);
+    return bilstm(enc);
 }
 
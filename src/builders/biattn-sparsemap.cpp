@@ -1,11 +1,15 @@
 #include "builders/biattn.h"
 #include "factors/FactorMatching.h"
+#include "factors/FactorPairBundle.h"
 #include "factors/FactorSequenceDistance.h"
+#include "factors/FactorTreeAlignment.h"
+#include "layers/sparse-entries.h"
 
 #include <dynet/devices.h>
 #include <dynet/param-init.h>
 #include <sparsemap.h>
 
+#include <algorithm>
 #include <cassert>
 
 namespace dy = dynet;
@@ -13,28 +17,101 @@ namespace dy = dynet;
 //
 // Utility functions
 
-// cannot use dy::ones since it is on gpu
-dy::Expression
-ravel(dy::Expression x)
+// linear indices (prem_sz * j + i) of the top-k hypothesis words of every
+// premise word, sorted
+std::vector<unsigned>
+topk_pairs(const dy::Expression& scores, unsigned k)
 {
-    return dy::reshape(x, { x.dim().size() });
+    auto d = scores.dim();
+    unsigned prem_sz = d[0], hypo_sz = d[1];
+    auto S = dy::as_vector(scores.value());
+
+    std::vector<unsigned> cols(hypo_sz);
+    std::vector<unsigned> pairs;
+    pairs.reserve(prem_sz * k);
+    for (size_t i = 0; i < prem_sz; ++i) {
+        for (size_t j = 0; j < hypo_sz; ++j)
+            cols[j] = j;
+        std::partial_sort(cols.begin(),
+                          cols.begin() + k,
+                          cols.end(),
+                          [&](unsigned a, unsigned b) {
+                              return S[prem_sz * a + i] > S[prem_sz * b + i];
+                          });
+        for (size_t r = 0; r < k; ++r)
+            pairs.push_back(prem_sz * cols[r] + i);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
 }
 
-dy::Expression
-ones_cpu(dy::ComputationGraph& cg, dy::Dim d)
+// Variables and matching factor over the given pairs (all of them if
+// `pairs` is empty), the factor living in `arena`. Returns the variable of
+// each pair, -1 if pruned, and the factor in `factor` if given.
+std::vector<int>
+add_matching(sparsemap::FactorArena& arena,
+             AD3::FactorGraph* fg,
+             size_t prem_sz,
+             size_t hypo_sz,
+             const std::vector<unsigned>& pairs,
+             sparsemap::FactorMatching** factor = nullptr)
 {
-    std::vector<float> data(d.size(), 1.0f);
-    auto* cpu = dy::get_device_manager()->get_global_device("CPU");
-    auto ones = dy::input(cg, d, data, cpu);
-    return ones;
+    std::vector<int> var_ix(prem_sz * hypo_sz, -1);
+    std::vector<AD3::BinaryVariable*> vars;
+    sparsemap::FactorMatching* matching;
+
+    if (pairs.empty()) {
+        for (size_t ij = 0; ij < prem_sz * hypo_sz; ++ij) {
+            var_ix[ij] = vars.size();
+            vars.push_back(fg->CreateBinaryVariable());
+        }
+        matching = arena.declare<sparsemap::FactorMatching>(fg, vars);
+        matching->Initialize(hypo_sz, prem_sz);
+    } else {
+        std::vector<std::vector<int>> allowed(hypo_sz);
+        for (auto ij : pairs) {
+            var_ix[ij] = vars.size();
+            vars.push_back(fg->CreateBinaryVariable());
+            allowed[ij / prem_sz].push_back(ij % prem_sz);
+        }
+        matching = arena.declare<sparsemap::FactorMatching>(fg, vars);
+        matching->Initialize(hypo_sz, prem_sz, allowed);
+    }
+    if (factor)
+        *factor = matching;
+    return var_ix;
+}
+
+// A single factor over all the pairs collected in pair_vars (two
+// endpoints each): the first pair_counts[0] pairs share additional
+// potential 0, the next pair_counts[1] share potential 1, and so on.
+void
+add_pair_bundle(sparsemap::FactorArena& arena,
+                AD3::FactorGraph* fg,
+                const std::vector<AD3::BinaryVariable*>& pair_vars,
+                const std::vector<unsigned>& pair_counts)
+{
+    std::vector<int> group;
+    for (size_t g = 0; g < pair_counts.size(); ++g)
+        group.insert(group.end(), pair_counts[g], g);
+    assert(pair_vars.size() == 2 * group.size());
+
+    auto* bundle = arena.declare<sparsemap::FactorPairBundle>(fg, pair_vars);
+    bundle->Initialize(group, pair_counts.size());
+    bundle->SetAdditionalLogPotentials(
+      std::vector<double>(pair_counts.size(), 0));
 }
 
+// Pair constraints are appended to pair_vars, to be declared together by
+// add_pair_bundle. var_ix maps pairs to variables, if some were pruned.
 unsigned
 add_head_pairs(AD3::FactorGraph* fg,
+               std::vector<AD3::BinaryVariable*>& pair_vars,
                size_t prem_sz,
                size_t hypo_sz,
                const std::vector<int>& prem_heads,
-               const std::vector<int>& hypo_heads)
+               const std::vector<int>& hypo_heads,
+               const std::vector<int>& var_ix = {})
 {
     unsigned n_pairs = 0;
     for (size_t j = 0; j < hypo_sz; ++j) {
@@ -44,11 +121,16 @@ add_head_pairs(AD3::FactorGraph* fg,
             int hj = hypo_heads.at(1 + j) - 1;
 
             if (hi >= 0 && hj >= 0) {
-                auto ij = prem_sz * j + i;
-                auto hihj = prem_sz * hj + hi;
-                auto var_ij = fg->GetBinaryVariable(ij);
-                auto var_hihj = fg->GetBinaryVariable(hihj);
-                fg->CreateFactorPAIR({ var_ij, var_hihj }, .0f);
+                int ij = prem_sz * j + i;
+                int hihj = prem_sz * hj + hi;
+                if (!var_ix.empty()) {
+                    ij = var_ix[ij];
+                    hihj = var_ix[hihj];
+                    if (ij < 0 || hihj < 0)
+                        continue;
+                }
+                pair_vars.push_back(fg->GetBinaryVariable(ij));
+                pair_vars.push_back(fg->GetBinaryVariable(hihj));
                 ++n_pairs;
             }
         }
@@ -58,10 +140,12 @@ add_head_pairs(AD3::FactorGraph* fg,
 
 unsigned
 add_cross_pairs(AD3::FactorGraph* fg,
+                std::vector<AD3::BinaryVariable*>& pair_vars,
                 size_t prem_sz,
                 size_t hypo_sz,
                 const std::vector<int>& prem_heads,
-                const std::vector<int>& hypo_heads)
+                const std::vector<int>& hypo_heads,
+                const std::vector<int>& var_ix = {})
 {
     unsigned n_pairs = 0;
     for (size_t j = 0; j < hypo_sz; ++j) {
@@ -71,11 +155,16 @@ add_cross_pairs(AD3::FactorGraph* fg,
             int hj = hypo_heads.at(1 + j) - 1;
 
             if (hi >= 0 && hj >= 0) {
-                auto i_hj = prem_sz * hj + i;
-                auto hi_j = prem_sz * j + hi;
-                auto var_i_hj = fg->GetBinaryVariable(i_hj);
-                auto var_hi_j = fg->GetBinaryVariable(hi_j);
-                fg->CreateFactorPAIR({ var_i_hj, var_hi_j }, .0f);
+                int i_hj = prem_sz * hj + i;
+                int hi_j = prem_sz * j + hi;
+                if (!var_ix.empty()) {
+                    i_hj = var_ix[i_hj];
+                    hi_j = var_ix[hi_j];
+                    if (i_hj < 0 || hi_j < 0)
+                        continue;
+                }
+                pair_vars.push_back(fg->GetBinaryVariable(i_hj));
+                pair_vars.push_back(fg->GetBinaryVariable(hi_j));
                 ++n_pairs;
             }
         }
@@ -83,12 +172,16 @@ add_cross_pairs(AD3::FactorGraph* fg,
     return n_pairs;
 }
 
+// Pairs (i, j)--(hi, gj), and (i, j)--(gi, hj) unless !prem_grandpa.
 unsigned
 add_grandpa_pairs(AD3::FactorGraph* fg,
+                  std::vector<AD3::BinaryVariable*>& pair_vars,
                   size_t prem_sz,
                   size_t hypo_sz,
                   const std::vector<int>& prem_heads,
-                  const std::vector<int>& hypo_heads)
+                  const std::vector<int>& hypo_heads,
+                  bool prem_grandpa = true,
+                  const std::vector<int>& var_ix = {})
 {
     // std::cout << prem_sz << " " << hypo_sz << std::endl;
     unsigned n_pairs = 0;
@@ -104,22 +197,32 @@ add_grandpa_pairs(AD3::FactorGraph* fg,
             // std::cout << hi <<' '<< hj <<' ' << gj << std::endl;
             // std::cout << hi << ' ' << gi <<' '<< gj << std::endl;
 
+            int ij = prem_sz * j + i;
+            if (!var_ix.empty())
+                ij = var_ix[ij];
+            if (ij < 0)
+                continue;
+
             if (hi >= 0 && hj >= 0 && gj >= 0) {
-                auto ij = prem_sz * j + i;
-                auto hi_gj = prem_sz * gj + hi;
-                auto var_ij = fg->GetBinaryVariable(ij);
-                auto var_higj = fg->GetBinaryVariable(hi_gj);
-                fg->CreateFactorPAIR({ var_ij, var_higj }, .0f);
-                ++n_pairs;
+                int hi_gj = prem_sz * gj + hi;
+                if (!var_ix.empty())
+                    hi_gj = var_ix[hi_gj];
+                if (hi_gj >= 0) {
+                    pair_vars.push_back(fg->GetBinaryVariable(ij));
+                    pair_vars.push_back(fg->GetBinaryVariable(hi_gj));
+                    ++n_pairs;
+                }
             }
 
-            if (hi >= 0 && gi >= 0 && hj >= 0) {
-                auto ij = prem_sz * j + i;
-                auto gi_hj = prem_sz * hj + gi;
-                auto var_ij = fg->GetBinaryVariable(ij);
-                auto var_gihj = fg->GetBinaryVariable(gi_hj);
-                fg->CreateFactorPAIR({ var_ij, var_gihj }, .0f);
-                ++n_pairs;
+            if (prem_grandpa && hi >= 0 && gi >= 0 && hj >= 0) {
+                int gi_hj = prem_sz * hj + gi;
+                if (!var_ix.empty())
+                    gi_hj = var_ix[gi_hj];
+                if (gi_hj >= 0) {
+                    pair_vars.push_back(fg->GetBinaryVariable(ij));
+                    pair_vars.push_back(fg->GetBinaryVariable(gi_hj));
+                    ++n_pairs;
+                }
             }
         }
     }
@@ -130,8 +233,10 @@ add_grandpa_pairs(AD3::FactorGraph* fg,
 // Constructors
 // ************
 
-MatchingBuilder::MatchingBuilder(const dy::SparseMAPOpts& opts)
+MatchingBuilder::MatchingBuilder(const dy::SparseMAPOpts& opts,
+                                 const MatchOpts& match_opts)
   : opts(opts)
+  , match_opts(match_opts)
 {}
 
 XORMatchingBuilder::XORMatchingBuilder(const dy::SparseMAPOpts& opts)
@@ -163,7 +268,8 @@ HeadPreservingBuilder::HeadPreservingBuilder(dy::ParameterCollection& params,
 
 HeadPreservingMatchingBuilder::HeadPreservingMatchingBuilder(
   dy::ParameterCollection& params,
-  const dy::SparseMAPOpts& opts)
+  const dy::SparseMAPOpts& opts,
+  const MatchOpts& match_opts)
   : p(params.add_subcollection("headattn"))
   , p_affinity(
       p.add_parameters({ 1 },
@@ -171,6 +277,7 @@ HeadPreservingMatchingBuilder::HeadPreservingMatchingBuilder(
                        "affinity",
                        dy::get_device_manager()->get_global_device("CPU")))
   , opts(opts)
+  , match_opts(match_opts)
 {}
 
 HeadHOBuilder::HeadHOBuilder(dy::ParameterCollection& params,
@@ -189,8 +296,9 @@ HeadHOBuilder::HeadHOBuilder(dy::ParameterCollection& params,
 {}
 
 HeadHOMatchingBuilder::HeadHOMatchingBuilder(dy::ParameterCollection& params,
-                                             const dy::SparseMAPOpts& opts)
-  : HeadPreservingMatchingBuilder(params, opts)
+                                             const dy::SparseMAPOpts& opts,
+                                             const MatchOpts& match_opts)
+  : HeadPreservingMatchingBuilder(params, opts, match_opts)
   , p_cross(
       p.add_parameters({ 1 },
                        dy::ParameterInitConst(1.0f),
@@ -208,42 +316,52 @@ HeadHOMatchingBuilder::HeadHOMatchingBuilder(dy::ParameterCollection& params,
 // ***
 
 void
-MatchingBuilder::new_graph(dy::ComputationGraph&, bool)
-{}
+MatchingBuilder::new_graph(dy::ComputationGraph& cg, bool training)
+{
+    BiAttentionBuilder::new_graph(cg, training);
+}
 
 void
-XORMatchingBuilder::new_graph(dy::ComputationGraph&, bool)
-{}
+XORMatchingBuilder::new_graph(dy::ComputationGraph& cg, bool training)
+{
+    BiAttentionBuilder::new_graph(cg, training);
+}
 
 void
-NeighborMatchingBuilder::new_graph(dy::ComputationGraph& cg, bool)
+NeighborMatchingBuilder::new_graph(dy::ComputationGraph& cg, bool training)
 {
+    BiAttentionBuilder::new_graph(cg, training);
     e_affinity = dy::parameter(cg, p_affinity);
 }
 
 void
-HeadPreservingBuilder::new_graph(dy::ComputationGraph& cg, bool)
+HeadPreservingBuilder::new_graph(dy::ComputationGraph& cg, bool training)
 {
+    BiAttentionBuilder::new_graph(cg, training);
     e_affinity = dy::parameter(cg, p_affinity);
 }
 
 void
-HeadPreservingMatchingBuilder::new_graph(dy::ComputationGraph& cg, bool)
+HeadPreservingMatchingBuilder::new_graph(dy::ComputationGraph& cg,
+                                         bool training)
 {
+    BiAttentionBuilder::new_graph(cg, training);
     e_affinity = dy::parameter(cg, p_affinity);
 }
 
 void
-HeadHOBuilder::new_graph(dy::ComputationGraph& cg, bool)
+HeadHOBuilder::new_graph(dy::ComputationGraph& cg, bool training)
 {
+    BiAttentionBuilder::new_graph(cg, training);
     e_affinity = dy::parameter(cg, p_affinity);
     e_cross = dy::parameter(cg, p_cross);
     e_grandpa = dy::parameter(cg, p_grandpa);
 }
 
 void
-HeadHOMatchingBuilder::new_graph(dy::ComputationGraph& cg, bool)
+HeadHOMatchingBuilder::new_graph(dy::ComputationGraph& cg, bool training)
 {
+    BiAttentionBuilder::new_graph(cg, training);
     e_affinity = dy::parameter(cg, p_affinity);
     e_cross = dy::parameter(cg, p_cross);
     e_grandpa = dy::parameter(cg, p_grandpa);
@@ -259,23 +377,28 @@ MatchingBuilder::attend(const dynet::Expression scores,
 
     auto fg = std::make_unique<AD3::FactorGraph>();
 
-    std::vector<AD3::BinaryVariable*> vars;
-    for (size_t j = 0; j < hypo_sz; ++j) {
-        for (size_t i = 0; i < prem_sz; ++i) {
-            auto var = fg->CreateBinaryVariable();
-            vars.push_back(var);
-        }
-    }
+    // only the top-k pairs of every premise word, if pruning
+    std::vector<unsigned> pairs;
+    unsigned topk = match_opts.topk;
+    if (topk > 0 && topk < hypo_sz)
+        pairs = topk_pairs(scores, topk);
 
     // MatchingFactor over all of them
-    auto* matching = new sparsemap::FactorMatching;
-    fg->DeclareFactor(matching, vars, /*owned_by_graph=*/true);
-    matching->Initialize(hypo_sz, prem_sz);
-
-    auto eta_u = dy::reshape(scores, { prem_sz * hypo_sz });
-    auto u = dy::sparsemap(eta_u, std::move(fg), opts);
+    sparsemap::FactorMatching* matching;
+    add_matching(arena, fg.get(), prem_sz, hypo_sz, pairs, &matching);
+    matching->SetAuction(match_opts.auction_eps);
 
-    u = dy::reshape(u, d);
+    dy::Expression u;
+    if (pairs.empty()) {
+        auto eta_u = dy::reshape(scores, { prem_sz * hypo_sz });
+        defer_map(matching, eta_u);
+        u = dy::sparsemap(eta_u, std::move(fg), opts);
+        u = dy::reshape(u, d);
+    } else {
+        auto eta_u = dy::gather_entries(scores, pairs);
+        u = dy::sparsemap(eta_u, std::move(fg), opts);
+        u = dy::scatter_entries(u, pairs, d);
+    }
 
     //std::cout << u.value() << std::endl;
     //std::cout << dy::sum_dim(u, {0u}).value() << std::endl;
@@ -320,34 +443,18 @@ XORMatchingBuilder::attend(const dynet::Expression scores,
     auto d = scores.dim();
     unsigned prem_sz = d[0], hypo_sz = d[1];
 
-    //std::cout << prem_sz << " " << hypo_sz << std::endl;
-
     assert(prem_sz >= hypo_sz);
 
     auto fg = std::make_unique<AD3::FactorGraph>();
 
-    std::vector<AD3::BinaryVariable*> vars;
-    std::vector<std::vector<AD3::BinaryVariable*>> vars_rows(prem_sz);
-    std::vector<AD3::BinaryVariable*> vars_col(prem_sz);
-
-    for (size_t j = 0; j < hypo_sz; ++j) {
-        for (size_t i = 0; i < prem_sz; ++i) {
-            auto var = fg->CreateBinaryVariable();
-            vars.push_back(var);
-            vars_col.at(i) = var;
-            vars_rows.at(i).push_back(var);
-        }
-
-        fg->CreateFactorXOR(vars_col);
-    }
-
-    if (hypo_sz > 1) {
-        for (size_t i = 0; i < prem_sz; ++i) {
-            fg->CreateFactorAtMostOne(vars_rows.at(i));
-        }
-    }
+    // every hypothesis word matched to a distinct premise word (XOR over
+    // each column, at most one per row) is a rectangular assignment: a
+    // single matching factor, with hypothesis words as its rows.
+    sparsemap::FactorMatching* matching;
+    add_matching(arena, fg.get(), prem_sz, hypo_sz, {}, &matching);
 
     auto eta_u = dy::reshape(scores, { prem_sz * hypo_sz });
+    defer_map(matching, eta_u);
     auto u = dy::sparsemap(eta_u, std::move(fg), opts);
 
     u = dy::reshape(u, d);
@@ -379,8 +486,8 @@ NeighborMatchingBuilder::attend(const dynet::Expression scores,
         }
     }
 
-    auto* seq = new sparsemap::FactorSequenceAdjacent;
-    fg->DeclareFactor(seq, vars, /*owned_by_graph=*/true);
+    auto* seq =
+      arena.declare<sparsemap::FactorSequenceAdjacent>(fg.get(), vars);
     seq->Initialize(hypo_sz, prem_sz);
 
     if (hypo_sz > 1) {
@@ -416,26 +523,16 @@ HeadPreservingBuilder::attend(const dynet::Expression scores,
     auto fg = std::make_unique<AD3::FactorGraph>();
 
     std::vector<AD3::BinaryVariable*> vars;
+    for (size_t ij = 0; ij < prem_sz * hypo_sz; ++ij)
+        vars.push_back(fg->CreateBinaryVariable());
 
-    std::vector<AD3::BinaryVariable*> vars_col(prem_sz);
-    for (size_t j = 0; j < hypo_sz; ++j) {
-        for (size_t i = 0; i < prem_sz; ++i) {
-            auto var = fg->CreateBinaryVariable();
-            vars.push_back(var);
-            vars_col.at(i) = var;
-        }
-
-        fg->CreateFactorXOR(vars_col);
-    }
-
-    // PairFactor between (i, j) and (head(i), head(j))
-    unsigned n_pairs =
-      add_head_pairs(fg.get(), prem_sz, hypo_sz, prem_heads, hypo_heads);
+    // one alignment per hypothesis word, rewarding (i, j) with
+    // (head(i), head(j)): exact DP over the hypothesis tree
+    auto* tree = arena.declare<sparsemap::FactorTreeAlignment>(fg.get(), vars);
+    tree->Initialize(prem_heads, hypo_heads);
 
-    auto ones = ones_cpu(*scores.pg, { n_pairs, 1 });
     auto eta_u = dy::reshape(scores, { prem_sz * hypo_sz });
-    auto eta_v = dy::reshape(ones * e_affinity, { n_pairs });
-    auto u = dy::sparsemap(eta_u, eta_v, std::move(fg), opts);
+    auto u = dy::sparsemap(eta_u, e_affinity, std::move(fg), opts);
 
     u = dy::reshape(u, d);
     return u;
@@ -452,29 +549,44 @@ HeadPreservingMatchingBuilder::attend(const dynet::Expression scores,
 
     auto fg = std::make_unique<AD3::FactorGraph>();
 
-    std::vector<AD3::BinaryVariable*> vars;
-    for (size_t j = 0; j < hypo_sz; ++j) {
-        for (size_t i = 0; i < prem_sz; ++i) {
-            auto var = fg->CreateBinaryVariable();
-            vars.push_back(var);
-        }
-    }
+    // only the top-k pairs of every premise word, if pruning
+    std::vector<unsigned> pairs;
+    unsigned topk = match_opts.topk;
+    if (topk > 0 && topk < hypo_sz)
+        pairs = topk_pairs(scores, topk);
 
     // MatchingFactor over all of them
-    auto* matching = new sparsemap::FactorMatching;
-    fg->DeclareFactor(matching, vars, /*owned_by_graph=*/true);
-    matching->Initialize(hypo_sz, prem_sz);
-
-    // PairFactor between (i, j) and (head(i), head(j))
-    unsigned n_pairs =
-      add_head_pairs(fg.get(), prem_sz, hypo_sz, prem_heads, hypo_heads);
+    sparsemap::FactorMatching* matching;
+    auto var_ix =
+      add_matching(arena, fg.get(), prem_sz, hypo_sz, pairs, &matching);
+    matching->SetAuction(match_opts.auction_eps);
+
+    // pairs between (i, j) and (head(i), head(j)), sharing e_affinity
+    std::vector<AD3::BinaryVariable*> pair_vars;
+    unsigned n_pairs = add_head_pairs(
+      fg.get(), pair_vars, prem_sz, hypo_sz, prem_heads, hypo_heads, var_ix);
+
+    // the batched LAP is only valid if AD3 will call Maximize on the
+    // raw scores, i.e. when the matching is the only factor
+    dy::Expression eta_u;
+    if (pairs.empty()) {
+        eta_u = dy::reshape(scores, { prem_sz * hypo_sz });
+        if (n_pairs == 0)
+            defer_map(matching, eta_u);
+    } else
+        eta_u = dy::gather_entries(scores, pairs);
 
-    auto ones = ones_cpu(*scores.pg, { n_pairs, 1 });
-    auto eta_u = dy::reshape(scores, { prem_sz * hypo_sz });
-    auto eta_v = dy::reshape(ones * e_affinity, { n_pairs });
-    auto u = dy::sparsemap(eta_u, eta_v, std::move(fg), opts);
+    dy::Expression u;
+    if (n_pairs > 0) {
+        add_pair_bundle(arena, fg.get(), pair_vars, { n_pairs });
+        u = dy::sparsemap(eta_u, e_affinity, std::move(fg), opts);
+    } else
+        u = dy::sparsemap(eta_u, std::move(fg), opts);
 
-    u = dy::reshape(u, d);
+    if (pairs.empty())
+        u = dy::reshape(u, d);
+    else
+        u = dy::scatter_entries(u, pairs, d);
 
     // std::cout << u.value() << std::endl;
     // std::cout << dy::sum_dim(u, {0u}).value() << std::endl;
@@ -494,58 +606,35 @@ HeadHOBuilder::attend(const dynet::Expression scores,
     auto fg = std::make_unique<AD3::FactorGraph>();
 
     std::vector<AD3::BinaryVariable*> vars;
-
-    std::vector<AD3::BinaryVariable*> vars_col(prem_sz);
-    for (size_t j = 0; j < hypo_sz; ++j) {
-        for (size_t i = 0; i < prem_sz; ++i) {
-            auto var = fg->CreateBinaryVariable();
-            vars.push_back(var);
-            vars_col.at(i) = var;
-        }
-        fg->CreateFactorXOR(vars_col);
-    }
-
-    // PairFactor between (i, j) and (head(i), head(j))
-    unsigned n_hd =
-      add_head_pairs(fg.get(), prem_sz, hypo_sz, prem_heads, hypo_heads);
-    unsigned n_cr =
-      add_cross_pairs(fg.get(), prem_sz, hypo_sz, prem_heads, hypo_heads);
-    unsigned n_gp =
-      add_grandpa_pairs(fg.get(), prem_sz, hypo_sz, prem_heads, hypo_heads);
-
-    // std::cerr << n_hd << " " << n_cr << " " << n_gp << std::endl;
-
-    // fg->Print(std::cout);
-    // fg->SetVerbosity(2);
+    for (size_t ij = 0; ij < prem_sz * hypo_sz; ++ij)
+        vars.push_back(fg->CreateBinaryVariable());
+
+    // head, cross and (gi, hj) grandparent pairs all follow hypothesis
+    // arcs, and are scored exactly by the tree factor
+    auto* tree = arena.declare<sparsemap::FactorTreeAlignment>(fg.get(), vars);
+    tree->Initialize(prem_heads, hypo_heads, /*higher_order=*/true);
+
+    // (hi, gj) grandparent pairs skip a hypothesis arc: separate factors
+    std::vector<AD3::BinaryVariable*> pair_vars;
+    unsigned n_gp = add_grandpa_pairs(fg.get(),
+                                      pair_vars,
+                                      prem_sz,
+                                      hypo_sz,
+                                      prem_heads,
+                                      hypo_heads,
+                                      /*prem_grandpa=*/false);
 
     auto eta_u = dy::reshape(scores, { prem_sz * hypo_sz });
 
-    auto* cg = scores.pg;
-    auto eta_v_hd = ravel(ones_cpu(*cg, { n_hd, 1 }) * e_affinity);
-    auto eta_v_cr = ravel(ones_cpu(*cg, { n_cr, 1 }) * e_cross);
-    auto eta_v_gp = ravel(ones_cpu(*cg, { n_gp, 1 }) * e_grandpa);
-
-    std::vector<dy::Expression> v_expr;
-    if (n_hd > 0)
-        v_expr.push_back(eta_v_hd);
-
-    if (n_cr > 0)
-        v_expr.push_back(eta_v_cr);
-
-    if (n_gp > 0)
-        v_expr.push_back(eta_v_gp);
-
-    dy::Expression u;
-    if (v_expr.size() > 0) {
-        auto eta_v = dy::concatenate(v_expr);
-        u = dy::sparsemap(eta_u, eta_v, std::move(fg), opts);
-    } else
-        u = dy::sparsemap(eta_u, std::move(fg), opts);
+    std::vector<dy::Expression> v_expr = { e_affinity, e_cross, e_grandpa };
+    if (n_gp > 0) {
+        add_pair_bundle(arena, fg.get(), pair_vars, { n_gp });
+        v_expr.push_back(e_grandpa);
+    }
+    auto eta_v = dy::concatenate(v_expr);
+    auto u = dy::sparsemap(eta_u, eta_v, std::move(fg), opts);
 
     u = dy::reshape(u, d);
-
-    // std::cout << u.value() << std::endl;
-    // std::abort();
     return u;
 }
 
@@ -560,50 +649,50 @@ HeadHOMatchingBuilder::attend(const dynet::Expression scores,
 
     auto fg = std::make_unique<AD3::FactorGraph>();
 
-    std::vector<AD3::BinaryVariable*> vars;
-    for (size_t j = 0; j < hypo_sz; ++j) {
-        for (size_t i = 0; i < prem_sz; ++i) {
-            auto var = fg->CreateBinaryVariable();
-            vars.push_back(var);
-        }
-    }
+    // only the top-k pairs of every premise word, if pruning
+    std::vector<unsigned> pairs;
+    unsigned topk = match_opts.topk;
+    if (topk > 0 && topk < hypo_sz)
+        pairs = topk_pairs(scores, topk);
 
     // MatchingFactor over all of them
-    auto* matching = new sparsemap::FactorMatching;
-    fg->DeclareFactor(matching, vars, /*owned_by_graph=*/true);
-    matching->Initialize(hypo_sz, prem_sz);
-
-    unsigned n_hd =
-      add_head_pairs(fg.get(), prem_sz, hypo_sz, prem_heads, hypo_heads);
-    unsigned n_cr =
-      add_cross_pairs(fg.get(), prem_sz, hypo_sz, prem_heads, hypo_heads);
-    unsigned n_gp =
-      add_grandpa_pairs(fg.get(), prem_sz, hypo_sz, prem_heads, hypo_heads);
-
-    auto eta_u = dy::reshape(scores, { prem_sz * hypo_sz });
-
-    auto* cg = scores.pg;
-    auto eta_v_hd = ravel(ones_cpu(*cg, { n_hd, 1 }) * e_affinity);
-    auto eta_v_cr = ravel(ones_cpu(*cg, { n_cr, 1 }) * e_cross);
-    auto eta_v_gp = ravel(ones_cpu(*cg, { n_gp, 1 }) * e_grandpa);
-
-    std::vector<dy::Expression> v_expr;
-    if (n_hd > 0)
-        v_expr.push_back(eta_v_hd);
-
-    if (n_cr > 0)
-        v_expr.push_back(eta_v_cr);
-
-    if (n_gp > 0)
-        v_expr.push_back(eta_v_gp);
-
+    sparsemap::FactorMatching* matching;
+    auto var_ix =
+      add_matching(arena, fg.get(), prem_sz, hypo_sz, pairs, &matching);
+    matching->SetAuction(match_opts.auction_eps);
+
+    std::vector<AD3::BinaryVariable*> pair_vars;
+    unsigned n_hd = add_head_pairs(
+      fg.get(), pair_vars, prem_sz, hypo_sz, prem_heads, hypo_heads, var_ix);
+    unsigned n_cr = add_cross_pairs(
+      fg.get(), pair_vars, prem_sz, hypo_sz, prem_heads, hypo_heads, var_ix);
+    unsigned n_gp = add_grandpa_pairs(fg.get(),
+                                      pair_vars,
+                                      prem_sz,
+                                      hypo_sz,
+                                      prem_heads,
+                                      hypo_heads,
+                                      /*prem_grandpa=*/true,
+                                      var_ix);
+
+    dy::Expression eta_u;
+    if (pairs.empty())
+        eta_u = dy::reshape(scores, { prem_sz * hypo_sz });
+    else
+        eta_u = dy::gather_entries(scores, pairs);
+
+    // one tied weight per kind of pair
     dy::Expression u;
-    if (v_expr.size() > 0) {
-        auto eta_v = dy::concatenate(v_expr);
+    if (n_hd + n_cr + n_gp > 0) {
+        add_pair_bundle(arena, fg.get(), pair_vars, { n_hd, n_cr, n_gp });
+        auto eta_v = dy::concatenate({ e_affinity, e_cross, e_grandpa });
         u = dy::sparsemap(eta_u, eta_v, std::move(fg), opts);
     } else
         u = dy::sparsemap(eta_u, std::move(fg), opts);
 
-    u = dy::reshape(u, d);
+    if (pairs.empty())
+        u = dy::reshape(u, d);
+    else
+        u = dy::scatter_entries(u, pairs, d);
     return u;
 }
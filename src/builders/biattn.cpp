@@ -8,11 +8,28 @@
 
 #include <iostream>
 
+#include "factors/FactorMatching.h"
+#include "layers/sinkhorn.h"
+#include "lapjv.h"
+#include "potentials.h"
+
 namespace dy = dynet;
 
 void
 BiAttentionBuilder::new_graph(dy::ComputationGraph&, bool)
-{}
+{
+    arena.reset();
+}
+
+std::vector<std::tuple<dynet::Expression, dynet::Expression>>
+BiAttentionBuilder::apply_batch(const std::vector<dynet::Expression>& scores,
+                                const NLIBatch& batch)
+{
+    std::vector<std::tuple<dy::Expression, dy::Expression>> out;
+    for (size_t i = 0; i < batch.size(); ++i)
+        out.push_back(apply(scores[i], batch[i]));
+    return out;
+}
 
 std::tuple<dynet::Expression, dynet::Expression>
 BiSoftmaxBuilder::apply(const dynet::Expression scores, const NLIPair&)
@@ -87,6 +104,64 @@ SymmBiAttnBuilder::apply(const dynet::Expression scores,
 
 }
 
+void
+SymmBiAttnBuilder::defer_map(sparsemap::FactorMatching* matching,
+                             const dynet::Expression& eta)
+{
+    if (batching)
+        deferred.emplace_back(matching, eta);
+}
+
+std::vector<std::tuple<dynet::Expression, dynet::Expression>>
+SymmBiAttnBuilder::apply_batch(const std::vector<dynet::Expression>& scores,
+                               const NLIBatch& batch)
+{
+    // printing needs the attention right away
+    batching = !out;
+    deferred.clear();
+    auto res = BiAttentionBuilder::apply_batch(scores, batch);
+    batching = false;
+
+    size_t n_maps = deferred.size();
+    std::vector<uint_t> sizes(n_maps);
+    std::vector<double**> costs(n_maps);
+    std::vector<int*> x(n_maps), y(n_maps);
+    std::vector<double*> v(n_maps);
+    std::vector<double> eta;
+
+    for (size_t k = 0; k < n_maps; ++k) {
+        auto* matching = deferred[k].first;
+        to_double(deferred[k].second.value(), eta);
+        matching->SetCosts(eta);
+        sizes[k] = matching->size();
+        costs[k] = matching->costs();
+        x[k] = matching->row_solution();
+        y[k] = matching->col_solution();
+        v[k] = matching->duals();
+    }
+
+    if (lapjv_batch(n_maps, sizes.data(), costs.data(), x.data(), y.data(),
+                    v.data()) == 0)
+        for (auto&& fe : deferred)
+            fe.first->SetSolved();
+
+    deferred.clear();
+    return res;
+}
+
+SinkhornBuilder::SinkhornBuilder(const MatchOpts& match_opts)
+  : match_opts(match_opts)
+{}
+
+dynet::Expression
+SinkhornBuilder::attend(const dynet::Expression scores,
+                        const std::vector<int>&,
+                        const std::vector<int>&)
+{
+    return dy::sinkhorn(
+      scores, match_opts.sinkhorn_iter, match_opts.sinkhorn_temp);
+}
+
 std::tuple<dynet::Expression, dynet::Expression>
 IndepBiAttnBuilder::apply(const dynet::Expression scores,
                           const NLIPair& sample)
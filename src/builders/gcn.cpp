@@ -1,6 +1,7 @@
 #include <dynet/param-init.h>
 
 #include "builders/gcn.h"
+#include "layers/gcn-layer.h"
 
 namespace dy = dynet;
 
@@ -15,12 +16,12 @@ GCNParams::GCNParams(dy::ParameterCollection& pc, unsigned dim_in, unsigned dim_
 
 GCNExprs::GCNExprs(dy::ComputationGraph& cg, GCNParams params)
 {
-    W_parents = dy::parameter(cg, params.W_parents);
-    b_parents = dy::parameter(cg, params.b_parents);
-    W_children = dy::parameter(cg, params.W_children);
-    b_children = dy::parameter(cg, params.b_children);
-    W_self = dy::parameter(cg, params.W_self);
-    b_self = dy::parameter(cg, params.b_self);
+    W = dy::concatenate({ dy::parameter(cg, params.W_self),
+                          dy::parameter(cg, params.W_parents),
+                          dy::parameter(cg, params.W_children) });
+    b = dy::concatenate({ dy::parameter(cg, params.b_self),
+                          dy::parameter(cg, params.b_parents),
+                          dy::parameter(cg, params.b_children) });
 }
 
 GCNBuilder::GCNBuilder(dy::ParameterCollection& pc,
@@ -58,27 +59,29 @@ GCNBuilder::new_graph(dy::ComputationGraph& cg, bool training)
 }
 
 dy::Expression
-GCNBuilder::apply(const dy::Expression& input, const dy::Expression& graph)
+GCNBuilder::apply(const dy::Expression& input, const GCNGraph& graph)
 {
     using dy::affine_transform;
 
     if (n_layers == 0)
         return input;
 
-    auto t_graph = dy::transpose(graph);
+    float p = _training ? dropout_rate : 0.f;
     auto h = input;
     for (auto i = 0u; i < n_layers; ++i) {
         auto ex = exprs.at(i);
 
-        auto self = affine_transform({ ex.b_self, ex.W_self, h });
-        auto parents = affine_transform({ ex.b_parents, ex.W_parents, h });
-        auto children = affine_transform({ ex.b_children, ex.W_children, h });
-        auto h_next = self + parents * graph + children * t_graph;
+        // [self; parents; children], then aggregation, dropout and relu
+        // in one node
+        auto z = affine_transform({ ex.b, ex.W, h });
 
-        if (_training)
-            h_next = dy::dropout(h_next, dropout_rate);
-
-        h_next = dy::rectify(h_next);
+        dy::Expression h_next;
+        if (graph.weighted)
+            h_next = dy::gcn_layer(z, graph.trees, graph.weights, p);
+        else if (graph.is_sparse())
+            h_next = dy::gcn_layer(z, graph.trees[0], p);
+        else
+            h_next = dy::gcn_layer(z, graph.adj, p);
 
         if (dense)
             h = dy::concatenate({ h, h_next });
@@ -89,6 +92,68 @@ GCNBuilder::apply(const dy::Expression& input, const dy::Expression& graph)
     return h;
 }
 
+std::vector<dy::Expression>
+GCNBuilder::apply_batch(const std::vector<dy::Expression>& inputs,
+                        const std::vector<GCNGraph>& graphs)
+{
+    using dy::affine_transform;
+
+    bool batchable = n_layers > 0 && !graphs.empty();
+    for (auto&& graph : graphs)
+        batchable = batchable && graph.is_sparse()
+                    && graph.weighted == graphs[0].weighted;
+
+    std::vector<dy::Expression> res;
+    res.reserve(inputs.size());
+    if (!batchable) {
+        for (size_t s = 0; s < inputs.size(); ++s)
+            res.push_back(apply(inputs[s], graphs[s]));
+        return res;
+    }
+
+    // every tree of sentence s starts at its first column
+    std::vector<std::vector<unsigned>> trees;
+    std::vector<unsigned> cols;
+    std::vector<dy::Expression> weights;
+    std::vector<unsigned> first_col;
+    unsigned n_cols = 0;
+    for (size_t s = 0; s < inputs.size(); ++s) {
+        first_col.push_back(n_cols);
+        for (auto&& tree : graphs[s].trees) {
+            trees.push_back(tree);
+            cols.push_back(n_cols);
+        }
+        if (graphs[s].weighted)
+            weights.push_back(graphs[s].weights);
+        n_cols += inputs[s].dim()[1];
+    }
+
+    float p = _training ? dropout_rate : 0.f;
+    bool weighted = graphs[0].weighted;
+    auto w = weighted ? dy::concatenate(weights) : dy::Expression{};
+    auto h = dy::concatenate_cols(inputs);
+    for (auto i = 0u; i < n_layers; ++i) {
+        auto ex = exprs.at(i);
+        auto z = affine_transform({ ex.b, ex.W, h });
+
+        dy::Expression h_next;
+        if (weighted)
+            h_next = dy::gcn_layer(z, trees, cols, w, p);
+        else
+            h_next = dy::gcn_layer(z, trees, cols, p);
+
+        if (dense)
+            h = dy::concatenate({ h, h_next });
+        else
+            h = h_next;
+    }
+
+    for (size_t s = 0; s < inputs.size(); ++s)
+        res.push_back(dy::pick_range(
+          h, first_col[s], first_col[s] + inputs[s].dim()[1], 1));
+    return res;
+}
+
 void
 GCNBuilder::set_dropout(float value)
 {
@@ -0,0 +1,280 @@
+#include "factors/BatchDependencyDecoder.h"
+#include "factors/DependencyDecoder.h"
+
+#include <limits>
+
+namespace {
+
+// Large but finite, so that sums stay comparable under -Ofast.
+const double pad_score = -1e30;
+const double neg_inf = -std::numeric_limits<double>::max();
+
+}
+
+void
+BatchDependencyDecoder::reset(int length, int batch_size)
+{
+    length_ = length;
+    batch_size_ = batch_size;
+    lengths_.assign(batch_size, 1);
+
+    const size_t sz = static_cast<size_t>(length) * length * batch_size;
+    scores_.assign(sz, pad_score);
+    best_.resize(batch_size);
+    arg_.resize(batch_size);
+}
+
+void
+BatchDependencyDecoder::set_scores(int b, int n, const float* scores)
+{
+    lengths_[b] = n;
+    for (int m = 1; m < n; ++m)
+        for (int h = 0; h < n; ++h)
+            if (h != m)
+                scores_[ix(h, m) + b] = scores[m * n + h];
+
+    // padding tokens form a chain below the last word.
+    for (int m = n; m < length_; ++m)
+        scores_[ix(m - 1, m) + b] = 0;
+}
+
+void
+BatchDependencyDecoder::run_eisner(std::vector<std::vector<int>>* heads,
+                                   std::vector<double>* values)
+{
+    const int n = length_;
+    const int B = batch_size_;
+
+    const size_t sz = static_cast<size_t>(n) * n * B;
+    complete_.assign(sz, 0.0);
+    incomplete_.assign(sz, 0.0);
+    complete_bt_.assign(sz, -1);
+    incomplete_bt_.assign(sz, -1);
+
+    double* best = best_.data();
+    int* arg = arg_.data();
+
+    for (int k = 1; k < n; ++k) {
+        for (int s = 1; s < n - k; ++s) {
+            int t = s + k;
+
+            // incomplete items s -> t and t -> s share the split point
+            for (int b = 0; b < B; ++b) {
+                best[b] = neg_inf;
+                arg[b] = s;
+            }
+            for (int u = s; u < t; ++u) {
+                const double* left = &complete_[ix(s, u)];
+                const double* right = &complete_[ix(t, u + 1)];
+                for (int b = 0; b < B; ++b) {
+                    double val = left[b] + right[b];
+                    if (val > best[b]) {
+                        best[b] = val;
+                        arg[b] = u;
+                    }
+                }
+            }
+            {
+                const double* sc_l = &scores_[ix(t, s)];
+                const double* sc_r = &scores_[ix(s, t)];
+                double* inc_l = &incomplete_[ix(t, s)];
+                double* inc_r = &incomplete_[ix(s, t)];
+                int* bt_l = &incomplete_bt_[ix(t, s)];
+                int* bt_r = &incomplete_bt_[ix(s, t)];
+                for (int b = 0; b < B; ++b) {
+                    inc_l[b] = best[b] + sc_l[b];
+                    inc_r[b] = best[b] + sc_r[b];
+                    bt_l[b] = arg[b];
+                    bt_r[b] = arg[b];
+                }
+            }
+
+            // left complete item t <- s
+            for (int b = 0; b < B; ++b) {
+                best[b] = neg_inf;
+                arg[b] = s;
+            }
+            for (int u = s; u < t; ++u) {
+                const double* cmp = &complete_[ix(u, s)];
+                const double* inc = &incomplete_[ix(t, u)];
+                for (int b = 0; b < B; ++b) {
+                    double val = cmp[b] + inc[b];
+                    if (val > best[b]) {
+                        best[b] = val;
+                        arg[b] = u;
+                    }
+                }
+            }
+            {
+                double* cmp = &complete_[ix(t, s)];
+                int* bt = &complete_bt_[ix(t, s)];
+                for (int b = 0; b < B; ++b) {
+                    cmp[b] = best[b];
+                    bt[b] = arg[b];
+                }
+            }
+
+            // right complete item s -> t
+            for (int b = 0; b < B; ++b) {
+                best[b] = neg_inf;
+                arg[b] = s + 1;
+            }
+            for (int u = s + 1; u <= t; ++u) {
+                const double* cmp = &complete_[ix(u, t)];
+                const double* inc = &incomplete_[ix(s, u)];
+                for (int b = 0; b < B; ++b) {
+                    double val = cmp[b] + inc[b];
+                    if (val > best[b]) {
+                        best[b] = val;
+                        arg[b] = u;
+                    }
+                }
+            }
+            {
+                double* cmp = &complete_[ix(s, t)];
+                int* bt = &complete_bt_[ix(s, t)];
+                for (int b = 0; b < B; ++b) {
+                    cmp[b] = best[b];
+                    bt[b] = arg[b];
+                }
+            }
+        }
+    }
+
+    // single root
+    for (int b = 0; b < B; ++b) {
+        best[b] = neg_inf;
+        arg[b] = 1;
+    }
+    for (int s = 1; s < n; ++s) {
+        const double* sc = &scores_[ix(0, s)];
+        const double* left = &complete_[ix(s, 1)];
+        const double* right = &complete_[ix(s, n - 1)];
+        for (int b = 0; b < B; ++b) {
+            double val = sc[b] + left[b] + right[b];
+            if (val > best[b]) {
+                best[b] = val;
+                arg[b] = s;
+            }
+        }
+    }
+
+    heads->resize(B);
+    values->assign(B, 0.0);
+    std::vector<int> padded_heads;
+    for (int b = 0; b < B; ++b) {
+        auto& hb = heads->at(b);
+        if (lengths_[b] <= 1) {
+            hb.assign(lengths_[b], -1);
+            continue;
+        }
+        padded_heads.assign(n, -1);
+        padded_heads[arg[b]] = 0;
+        backtrack(b, arg[b], 1, true, &padded_heads);
+        backtrack(b, arg[b], n - 1, true, &padded_heads);
+        hb.assign(padded_heads.begin(), padded_heads.begin() + lengths_[b]);
+        values->at(b) = best[b];
+    }
+}
+
+void
+BatchDependencyDecoder::backtrack(int b,
+                                  int h,
+                                  int m,
+                                  bool complete,
+                                  std::vector<int>* heads)
+{
+    if (h == m)
+        return;
+    if (complete) {
+        int u = complete_bt_[ix(h, m) + b];
+        backtrack(b, h, u, false, heads);
+        backtrack(b, u, m, true, heads);
+    } else {
+        (*heads)[m] = h;
+        int u = incomplete_bt_[ix(h, m) + b];
+        if (h < m) {
+            backtrack(b, h, u, true, heads);
+            backtrack(b, m, u + 1, true, heads);
+        } else {
+            backtrack(b, m, u, true, heads);
+            backtrack(b, h, u + 1, true, heads);
+        }
+    }
+}
+
+void
+BatchDependencyDecoder::run_chu_liu_edmonds(
+  std::vector<std::vector<int>>* heads,
+  std::vector<double>* values)
+{
+    const int n = length_;
+    const int B = batch_size_;
+
+    heads->resize(B);
+    values->assign(B, 0.0);
+    for (int b = 0; b < B; ++b)
+        heads->at(b).assign(lengths_[b], -1);
+
+    double* best = best_.data();
+    int* arg = arg_.data();
+
+    // best incoming arc of every word, for all sentences at once
+    for (int m = 1; m < n; ++m) {
+        for (int b = 0; b < B; ++b) {
+            best[b] = neg_inf;
+            arg[b] = 0;
+        }
+        for (int h = 0; h < n; ++h) {
+            if (h == m)
+                continue;
+            const double* sc = &scores_[ix(h, m)];
+            for (int b = 0; b < B; ++b) {
+                if (sc[b] > best[b]) {
+                    best[b] = sc[b];
+                    arg[b] = h;
+                }
+            }
+        }
+        for (int b = 0; b < B; ++b) {
+            if (m < lengths_[b]) {
+                heads->at(b)[m] = arg[b];
+                values->at(b) += best[b];
+            }
+        }
+    }
+
+    // sentences whose greedy graph is not a tree need contractions
+    DependencyDecoder decoder;
+    std::vector<int> visited;
+    for (int b = 0; b < B; ++b) {
+        auto& hb = heads->at(b);
+        const int len = lengths_[b];
+
+        bool has_cycle = false;
+        visited.assign(len, 0);
+        for (int m = 1; m < len && !has_cycle; ++m) {
+            int h = m;
+            while (h != 0 && !visited[h]) {
+                visited[h] = m;
+                h = hb[h];
+            }
+            has_cycle = (h != 0 && visited[h] == m);
+        }
+
+        if (!has_cycle)
+            continue;
+
+        std::vector<std::vector<int>> index_arcs(len, std::vector<int>(len, -1));
+        std::vector<double> scores;
+        for (int m = 1; m < len; ++m) {
+            for (int h = 0; h < len; ++h) {
+                if (h != m) {
+                    index_arcs[h][m] = scores.size();
+                    scores.push_back(scores_[ix(h, m) + b]);
+                }
+            }
+        }
+        decoder.RunChuLiuEdmonds(len, index_arcs, scores, &hb, &values->at(b));
+    }
+}
@@ -233,6 +233,130 @@ void DependencyDecoder::RunChuLiuEdmonds(int sentence_length,
                             &candidate_scores, heads, value);
 }
 
+void DependencyDecoder::RunChuLiuEdmondsDense(
+  int sentence_length,
+  const vector<vector<int> > &index_arcs,
+  const vector<double> &scores,
+  vector<int> *heads,
+  double *value) {
+  const int n = sentence_length;
+  vector<double> weights(n * n, -std::numeric_limits<double>::infinity());
+  for (int h = 0; h < n; ++h) {
+    for (int m = 1; m < n; ++m) {
+      int r = index_arcs[h][m];
+      if (r >= 0) weights[h * n + m] = scores[r];
+    }
+  }
+
+  RunChuLiuEdmondsDenseIteration(n, weights, heads);
+
+  *value = 0.0;
+  for (int m = 1; m < n; ++m) {
+    int r = index_arcs[(*heads)[m]][m];
+    *value += r >= 0 ? scores[r] : -std::numeric_limits<double>::infinity();
+  }
+}
+
+// One level of dense Chu-Liu-Edmonds: weights[h * length + m] is the score
+// of h -> m. Picks the best head of every node; if that closes a cycle,
+// contracts it into a single node (the last one of a smaller matrix),
+// solves that recursively and expands the cycle back.
+void DependencyDecoder::RunChuLiuEdmondsDenseIteration(
+  int length,
+  const vector<double> &weights,
+  vector<int> *heads) {
+  const double kNegInf = -std::numeric_limits<double>::infinity();
+  heads->assign(length, -1);
+  for (int m = 1; m < length; ++m) {
+    double best = kNegInf;
+    for (int h = 0; h < length; ++h) {
+      if (h == m) continue;
+      double w = weights[h * length + m];
+      if ((*heads)[m] < 0 || w > best) {
+        (*heads)[m] = h;
+        best = w;
+      }
+    }
+  }
+
+  // Look for a cycle, as in RunChuLiuEdmondsIteration.
+  vector<int> cycle;
+  vector<int> visited(length, 0);
+  for (int m = 1; m < length && cycle.empty(); ++m) {
+    int h = m;
+    while (h != 0 && !visited[h]) {
+      visited[h] = m;
+      h = (*heads)[h];
+    }
+    if (h != 0 && visited[h] == m) {
+      int k = h;
+      do {
+        cycle.push_back(k);
+        k = (*heads)[k];
+      } while (k != h);
+    }
+  }
+  if (cycle.empty()) return;
+
+  // Contract: nodes out of the cycle keep their order (so the root stays
+  // 0), and the cycle becomes node c.
+  vector<bool> in_cycle(length, false);
+  for (int k : cycle) in_cycle[k] = true;
+  vector<int> to_new(length, -1), to_old;
+  for (int v = 0; v < length; ++v) {
+    if (in_cycle[v]) continue;
+    to_new[v] = to_old.size();
+    to_old.push_back(v);
+  }
+  const int c = to_old.size();
+  const int contracted_length = c + 1;
+
+  vector<double> contracted(contracted_length * contracted_length, kNegInf);
+  vector<int> enter(length, -1);  // cycle node entered from outside node u
+  vector<int> leave(length, -1);  // cycle node left towards outside node v
+  for (int u = 0; u < length; ++u) {
+    if (in_cycle[u]) continue;
+    int nu = to_new[u];
+    for (int v = 1; v < length; ++v) {
+      if (in_cycle[v] || v == u) continue;
+      contracted[nu * contracted_length + to_new[v]] = weights[u * length + v];
+    }
+    // Entering the cycle at v replaces the arc (heads[v], v).
+    double &into = contracted[nu * contracted_length + c];
+    for (int v : cycle) {
+      double w = weights[u * length + v] - weights[(*heads)[v] * length + v];
+      if (enter[u] < 0 || w > into) {
+        enter[u] = v;
+        into = w;
+      }
+    }
+  }
+  for (int v = 1; v < length; ++v) {
+    if (in_cycle[v]) continue;
+    double &out = contracted[c * contracted_length + to_new[v]];
+    for (int u : cycle) {
+      double w = weights[u * length + v];
+      if (leave[v] < 0 || w > out) {
+        leave[v] = u;
+        out = w;
+      }
+    }
+  }
+
+  vector<int> contracted_heads;
+  RunChuLiuEdmondsDenseIteration(contracted_length, contracted,
+                                 &contracted_heads);
+
+  // Expand: the cycle keeps its arcs except into the node it is entered at.
+  for (int v = 1; v < length; ++v) {
+    if (in_cycle[v]) continue;
+    int h = contracted_heads[to_new[v]];
+    (*heads)[v] = h == c ? leave[v] : to_old[h];
+  }
+  int u = to_old[contracted_heads[c]];
+  (*heads)[enter[u]] = u;
+}
+
 // Run Eisner's algorithm for finding a maximal weighted projective dependency
 // tree.
 void DependencyDecoder::RunEisner(int sentence_length,
@@ -386,3 +510,171 @@ void DependencyDecoder::RunEisnerBacktrack(
   }
 }
 
+
+// Eisner's algorithm with a bound on the number of modifiers of each word.
+// Spans keep track of how many modifiers their head has on the inner side
+// (and incomplete spans also of the modifier's modifiers towards the head),
+// so that both halves of a word can be checked against the bound when its
+// complete spans are combined.
+void DependencyDecoder::RunEisnerValency(int sentence_length,
+                                         const vector<vector<int> > &index_arcs,
+                                         const vector<double> &scores,
+                                         int max_valency,
+                                         vector<int> *heads,
+                                         double *value) {
+  const double kInvalid = -1e100;
+  const double kThreshold = -1e99;
+  const int n = sentence_length;
+  const int W = max_valency + 1;
+
+  heads->assign(n, -1);
+  valency_length_ = n;
+  valency_width_ = W;
+  valency_complete_.assign(n * n * W, kInvalid);
+  valency_incomplete_.assign(n * n * W * W, kInvalid);
+  valency_complete_backtrack_.assign(n * n * W, -1);
+  valency_incomplete_backtrack_.assign(n * n * W * W, -1);
+
+  auto C = [&](int h, int m, int a) -> double& {
+    return valency_complete_[(h * n + m) * W + a];
+  };
+  auto I = [&](int h, int m, int a, int b) -> double& {
+    return valency_incomplete_[((h * n + m) * W + a) * W + b];
+  };
+
+  for (int s = 0; s < n; ++s) C(s, s, 0) = 0.0;
+
+  vector<double> prefix(W);
+  vector<int> prefix_arg(W);
+
+  for (int k = 1; k < n; ++k) {
+    for (int s = 1; s < n - k; ++s) {
+      int t = s + k;
+
+      // Incomplete items. I(s, t, a, b): s has a right modifiers, the last
+      // one being t, and t has b left modifiers.
+      for (int dir = 0; dir < 2; ++dir) {
+        int h = dir == 0 ? s : t;
+        int m = dir == 0 ? t : s;
+        int r = index_arcs[h][m];
+        if (r < 0) continue;
+        for (int a = 1; a < W; ++a) {
+          for (int b = 0; b < W; ++b) {
+            // the head uses a - 1 modifiers inside, the modifier b.
+            int a_s = dir == 0 ? a - 1 : b;
+            int a_t = dir == 0 ? b : a - 1;
+            double best_value = kInvalid;
+            int best = -1;
+            for (int u = s; u < t; ++u) {
+              double left = C(s, u, a_s);
+              double right = C(t, u + 1, a_t);
+              if (left < kThreshold || right < kThreshold) continue;
+              double val = left + right;
+              if (best < 0 || val > best_value) {
+                best = u;
+                best_value = val;
+              }
+            }
+            if (best < 0) continue;
+            I(h, m, a, b) = best_value + scores[r];
+            valency_incomplete_backtrack_[((h * n + m) * W + a) * W + b] = best;
+          }
+        }
+      }
+
+      // Complete items. C(h, m, a) = I(h, u, a, b) + C(u, m, c), b + c <= W-1.
+      for (int dir = 0; dir < 2; ++dir) {
+        int h = dir == 0 ? s : t;
+        int m = dir == 0 ? t : s;
+        int u_begin = dir == 0 ? s + 1 : s;
+        int u_end = dir == 0 ? t : t - 1;
+        for (int a = 1; a < W; ++a) {
+          double best_value = kInvalid;
+          int best = -1;
+          for (int u = u_begin; u <= u_end; ++u) {
+            // prefix[j]: best incomplete item with at most j inner modifiers
+            // on the modifier u.
+            for (int b = 0; b < W; ++b) {
+              double val = I(h, u, a, b);
+              prefix[b] = val;
+              prefix_arg[b] = b;
+              if (b > 0 && prefix[b - 1] >= val) {
+                prefix[b] = prefix[b - 1];
+                prefix_arg[b] = prefix_arg[b - 1];
+              }
+            }
+            for (int c = 0; c < W; ++c) {
+              double inc = prefix[W - 1 - c];
+              double cmp = C(u, m, c);
+              if (inc < kThreshold || cmp < kThreshold) continue;
+              double val = inc + cmp;
+              if (best < 0 || val > best_value) {
+                best = (u * W + prefix_arg[W - 1 - c]) * W + c;
+                best_value = val;
+              }
+            }
+          }
+          if (best < 0) continue;
+          C(h, m, a) = best_value;
+          valency_complete_backtrack_[(h * n + m) * W + a] = best;
+        }
+      }
+    }
+  }
+
+  // Get the optimal (single) root.
+  double best_value = kInvalid;
+  int best = -1, best_left = -1, best_right = -1;
+  for (int s = 1; s < n; ++s) {
+    int arc_index = index_arcs[0][s];
+    if (arc_index < 0) continue;
+    for (int a = 0; a < W; ++a) {
+      double left = C(s, 1, a);
+      if (left < kThreshold) continue;
+      for (int c = 0; a + c < W; ++c) {
+        double right = C(s, n - 1, c);
+        if (right < kThreshold) continue;
+        double val = left + right + scores[arc_index];
+        if (best < 0 || val > best_value) {
+          best = s;
+          best_left = a;
+          best_right = c;
+          best_value = val;
+        }
+      }
+    }
+  }
+
+  *value = best_value;
+  if (best < 0) return;
+  (*heads)[best] = 0;
+
+  RunEisnerValencyBacktrack(best, 1, best_left, 0, true, heads);
+  RunEisnerValencyBacktrack(best, n - 1, best_right, 0, true, heads);
+}
+
+void DependencyDecoder::RunEisnerValencyBacktrack(int h, int m, int a, int b,
+                                                  bool complete,
+                                                  vector<int> *heads) {
+  if (h == m) return;
+  const int n = valency_length_;
+  const int W = valency_width_;
+  if (complete) {
+    int packed = valency_complete_backtrack_[(h * n + m) * W + a];
+    int c = packed % W;
+    int inner = (packed / W) % W;
+    int u = packed / (W * W);
+    RunEisnerValencyBacktrack(h, u, a, inner, false, heads);
+    RunEisnerValencyBacktrack(u, m, c, 0, true, heads);
+  } else {
+    (*heads)[m] = h;
+    int u = valency_incomplete_backtrack_[((h * n + m) * W + a) * W + b];
+    if (h < m) {
+      RunEisnerValencyBacktrack(h, u, a - 1, 0, true, heads);
+      RunEisnerValencyBacktrack(m, u + 1, b, 0, true, heads);
+    } else {
+      RunEisnerValencyBacktrack(m, u, b, 0, true, heads);
+      RunEisnerValencyBacktrack(h, u + 1, a - 1, 0, true, heads);
+    }
+  }
+}
@@ -0,0 +1,215 @@
+#include "layers/gcn-layer.h"
+#include <dynet/globals.h>
+#include <dynet/nodes-impl-macros.h>
+#include <dynet/tensor-eigen.h>
+
+#include <random>
+
+namespace dynet {
+
+Expression
+gcn_layer(const Expression& Z, const Expression& G, float p)
+{
+    return Expression(Z.pg,
+                      Z.pg->add_function<GCNLayer>(
+                        { Z.i, G.i }, std::vector<std::vector<unsigned>>{},
+                        std::vector<unsigned>{}, p));
+}
+
+Expression
+gcn_layer(const Expression& Z, const std::vector<unsigned>& heads, float p)
+{
+    return gcn_layer(Z, { heads }, std::vector<unsigned>{ 0 }, p);
+}
+
+Expression
+gcn_layer(const Expression& Z,
+          const std::vector<std::vector<unsigned>>& trees,
+          const Expression& w,
+          float p)
+{
+    return gcn_layer(Z, trees, std::vector<unsigned>(trees.size(), 0), w, p);
+}
+
+Expression
+gcn_layer(const Expression& Z,
+          const std::vector<std::vector<unsigned>>& trees,
+          const std::vector<unsigned>& cols,
+          float p)
+{
+    return Expression(Z.pg,
+                      Z.pg->add_function<GCNLayer>({ Z.i }, trees, cols, p));
+}
+
+Expression
+gcn_layer(const Expression& Z,
+          const std::vector<std::vector<unsigned>>& trees,
+          const std::vector<unsigned>& cols,
+          const Expression& w,
+          float p)
+{
+    return Expression(Z.pg,
+                      Z.pg->add_function<GCNLayer>(
+                        { Z.i, w.i }, trees, cols, p));
+}
+
+GCNLayer::GCNLayer(const std::initializer_list<VariableIndex>& a,
+                   const std::vector<std::vector<unsigned>>& trees,
+                   const std::vector<unsigned>& cols,
+                   float dropout_p)
+    : Node(a)
+    , trees(trees.begin(), trees.end())
+    , cols(cols)
+    , dropout_p(dropout_p)
+{ }
+
+std::string
+GCNLayer::as_string(const std::vector<std::string>& arg_names) const
+{
+    std::ostringstream s;
+    s << "gcn-layer(";
+    for (auto&& arg_name : arg_names)
+        s << arg_name << ", ";
+    s << "p=" << dropout_p << ")";
+    return s.str();
+}
+
+Dim
+GCNLayer::dim_forward(const std::vector<Dim>& d) const
+{
+    DYNET_ARG_CHECK(d[0].nd == 2 && d[0][0] % 3 == 0 && d[0].bd == 1,
+                    "gcn-layer expects one 3d x (1 + n) matrix, got "
+                      << d[0]);
+    unsigned n_nodes = d[0][1];
+    if (dense()) {
+        DYNET_ARG_CHECK(d[1].nd == 2 && d[1][0] == n_nodes
+                          && d[1][1] == n_nodes && d[1].bd == 1,
+                        "gcn-layer expects a (1 + n) x (1 + n) adjacency, got "
+                          << d[1]);
+    } else if (d.size() > 1) {
+        DYNET_ARG_CHECK(d[1].size() == trees.size() && d[1].bd == 1,
+                        "gcn-layer expects one weight per tree, got " << d[1]);
+    }
+    DYNET_ARG_CHECK(cols.size() == trees.size(),
+                    "gcn-layer expects a first column per tree");
+    for (size_t k = 0; k < trees.size(); ++k)
+        DYNET_ARG_CHECK(cols[k] + trees[k].heads.size() < n_nodes,
+                        "gcn-layer: tree " << k << " goes past the "
+                          << n_nodes << " nodes");
+    return Dim({ d[0][0] / 3, n_nodes });
+}
+
+size_t
+GCNLayer::aux_storage_size() const
+{
+    // the dropout mask
+    return dropout_p > 0 ? dim.size() * sizeof(float) : 0;
+}
+
+template<class MyDevice>
+void
+GCNLayer::forward_dev_impl(const MyDevice&,
+                           const std::vector<const Tensor*>& xs,
+                           Tensor& fx) const
+{
+    unsigned d = fx.d[0], n_nodes = fx.d[1];
+    auto Z = mat(*xs[0]);
+    auto Y = mat(fx);
+
+    Y = Z.topRows(d);
+    if (dense()) {
+        auto G = mat(*xs[1]);
+        Y.noalias() += Z.middleRows(d, d) * G;
+        Y.noalias() += Z.bottomRows(d) * G.transpose();
+    } else {
+        for (size_t k = 0; k < trees.size(); ++k) {
+            float w = xs.size() > 1 ? xs[1]->v[k] : 1;
+            const float* z = xs[0]->v + 3 * d * cols[k];
+            float* y = fx.v + d * cols[k];
+            trees[k].add_parents(d, w, z + d, 3 * d, y, d);
+            trees[k].add_children(d, w, z + 2 * d, 3 * d, y, d);
+        }
+    }
+
+    if (dropout_p > 0) {
+        float* mask = static_cast<float*>(aux_mem);
+        std::bernoulli_distribution keep(1 - dropout_p);
+        for (unsigned k = 0; k < d * n_nodes; ++k)
+            mask[k] = keep(*rndeng) ? 1 / (1 - dropout_p) : 0;
+        Y.array() *= Eigen::Map<Eigen::ArrayXXf>(mask, d, n_nodes);
+    }
+
+    Y = Y.cwiseMax(0);
+}
+
+void
+GCNLayer::backward_pre(const Tensor& fx,
+                       const Tensor& dEdf,
+                       std::vector<float>& dpre) const
+{
+    // through the relu, then the dropout mask
+    size_t size = fx.d.size();
+    const float* mask = static_cast<const float*>(aux_mem);
+    dpre.resize(size);
+    for (size_t k = 0; k < size; ++k) {
+        dpre[k] = fx.v[k] > 0 ? dEdf.v[k] : 0;
+        if (dropout_p > 0)
+            dpre[k] *= mask[k];
+    }
+}
+
+template<class MyDevice>
+void
+GCNLayer::backward_dev_impl(const MyDevice&,
+                            const std::vector<const Tensor*>& xs,
+                            const Tensor& fx,
+                            const Tensor& dEdf,
+                            unsigned i,
+                            Tensor& dEdxi) const
+{
+    unsigned d = fx.d[0], n_nodes = fx.d[1];
+    std::vector<float> dpre;
+    backward_pre(fx, dEdf, dpre);
+    Eigen::Map<const Eigen::MatrixXf> dP(dpre.data(), d, n_nodes);
+    auto Z = mat(*xs[0]);
+
+    if (i == 0) {
+        // dZ_self = dP, dZ_parents = dP G', dZ_children = dP G
+        auto dZ = mat(dEdxi);
+        dZ.topRows(d) += dP;
+        if (dense()) {
+            auto G = mat(*xs[1]);
+            dZ.middleRows(d, d).noalias() += dP * G.transpose();
+            dZ.bottomRows(d).noalias() += dP * G;
+            return;
+        }
+        for (size_t k = 0; k < trees.size(); ++k) {
+            float w = xs.size() > 1 ? xs[1]->v[k] : 1;
+            const float* dp = dpre.data() + d * cols[k];
+            float* dz = dEdxi.v + 3 * d * cols[k];
+            trees[k].add_children(d, w, dp, d, dz + d, 3 * d);
+            trees[k].add_parents(d, w, dp, d, dz + 2 * d, 3 * d);
+        }
+        return;
+    }
+
+    if (dense()) {
+        // dG = Z_parents' dP + dP' Z_children
+        auto dG = mat(dEdxi);
+        dG.noalias() += Z.middleRows(d, d).transpose() * dP;
+        dG.noalias() += dP.transpose() * Z.bottomRows(d);
+        return;
+    }
+
+    // dw_k = <dP, Z_parents G_k> + <Z_children, dP G_k>
+    for (size_t k = 0; k < trees.size(); ++k) {
+        const float* dp = dpre.data() + d * cols[k];
+        const float* z = xs[0]->v + 3 * d * cols[k];
+        dEdxi.v[k] += trees[k].dot_parents(d, dp, d, z + d, 3 * d)
+                    + trees[k].dot_parents(d, z + 2 * d, 3 * d, dp, d);
+    }
+}
+
+DYNET_NODE_INST_DEV_IMPL(GCNLayer)
+
+}
@@ -0,0 +1,153 @@
+#include "layers/sinkhorn.h"
+#include <dynet/nodes-impl-macros.h>
+#include <dynet/tensor-eigen.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace dynet {
+
+using Eigen::ArrayXf;
+using Eigen::ArrayXXf;
+
+Expression
+sinkhorn(const Expression& scores, unsigned n_iter, float temperature)
+{
+    return Expression(
+      scores.pg,
+      scores.pg->add_function<Sinkhorn>({ scores.i }, n_iter, temperature));
+}
+
+Sinkhorn::Sinkhorn(const std::initializer_list<VariableIndex>& a,
+                   unsigned n_iter,
+                   float temperature)
+    : Node(a)
+    , n_iter(n_iter)
+    , temperature(temperature)
+{ }
+
+std::string
+Sinkhorn::as_string(const std::vector<std::string>& arg_names) const
+{
+    std::ostringstream s;
+    s << "sinkhorn(" << arg_names[0] << ", n_iter=" << n_iter
+      << ", temperature=" << temperature << ")";
+    return s.str();
+}
+
+Dim
+Sinkhorn::dim_forward(const std::vector<Dim>& xs) const
+{
+    DYNET_ARG_CHECK(xs.size() == 1 && xs[0].nd <= 2 && xs[0].bd == 1,
+                    "sinkhorn expects a single (unbatched) matrix");
+    return xs[0];
+}
+
+namespace {
+
+// log of the row and column marginals
+float log_row_mass(const ArrayXXf& X)
+{
+    return std::log(float(std::min(X.rows(), X.cols())) / X.rows());
+}
+
+float log_col_mass(const ArrayXXf& X)
+{
+    return std::log(float(std::min(X.rows(), X.cols())) / X.cols());
+}
+
+// log-sum-exp of every row of X + g^T
+ArrayXf row_lse(const ArrayXXf& X, const ArrayXf& g)
+{
+    ArrayXXf M = X.rowwise() + g.transpose();
+    ArrayXf mx = M.rowwise().maxCoeff();
+    return mx + (M.colwise() - mx).exp().rowwise().sum().log();
+}
+
+// log-sum-exp of every column of X + f
+ArrayXf col_lse(const ArrayXXf& X, const ArrayXf& f)
+{
+    ArrayXXf M = X.colwise() + f;
+    ArrayXf mx = M.colwise().maxCoeff().transpose();
+    return mx + (M.rowwise() - mx.transpose()).exp().colwise().sum()
+                  .log().transpose();
+}
+
+// the row and column potentials after each iteration; g[0] = 0.
+void sinkhorn_iterates(const ArrayXXf& X,
+                       unsigned n_iter,
+                       std::vector<ArrayXf>& f,
+                       std::vector<ArrayXf>& g)
+{
+    float la = log_row_mass(X), lb = log_col_mass(X);
+    f.assign(n_iter + 1, ArrayXf::Zero(X.rows()));
+    g.assign(n_iter + 1, ArrayXf::Zero(X.cols()));
+    for (unsigned t = 1; t <= n_iter; ++t) {
+        f[t] = la - row_lse(X, g[t - 1]);
+        g[t] = lb - col_lse(X, f[t]);
+    }
+}
+
+ArrayXXf plan(const ArrayXXf& X, const ArrayXf& f, const ArrayXf& g)
+{
+    return ((X.colwise() + f).rowwise() + g.transpose()).exp();
+}
+
+}
+
+template<class MyDevice>
+void
+Sinkhorn::forward_dev_impl(const MyDevice&,
+                           const std::vector<const Tensor*>& xs,
+                           Tensor& fx) const
+{
+    ArrayXXf X = mat(*xs[0]).array() / temperature;
+    std::vector<ArrayXf> f, g;
+    sinkhorn_iterates(X, n_iter, f, g);
+    mat(fx) = plan(X, f[n_iter], g[n_iter]).matrix();
+}
+
+/* Reverse pass through the iterations, recomputed from the input.
+ * With Q the column softmax of X + f[t] and R the row softmax of
+ * X + g[t - 1], g[t] = lb - lse_i(X + f[t]) sends -Q * dg back to X and
+ * f[t], and f[t] = la - lse_j(X + g[t - 1]) sends -R * df to X and
+ * g[t - 1]. */
+template<class MyDevice>
+void
+Sinkhorn::backward_dev_impl(const MyDevice&,
+                            const std::vector<const Tensor*>& xs,
+                            const Tensor& fx,
+                            const Tensor& dEdf,
+                            unsigned i,
+                            Tensor& dEdxi) const
+{
+    assert(i == 0);
+    ArrayXXf X = mat(*xs[0]).array() / temperature;
+    std::vector<ArrayXf> f, g;
+    sinkhorn_iterates(X, n_iter, f, g);
+    float la = log_row_mass(X), lb = log_col_mass(X);
+
+    // gradient wrt log P
+    ArrayXXf Z = mat(dEdf).array() * mat(fx).array();
+    ArrayXXf dX = Z;
+    ArrayXf df = Z.rowwise().sum();
+    ArrayXf dg = Z.colwise().sum().transpose();
+
+    for (unsigned t = n_iter; t >= 1; --t) {
+        ArrayXXf W = plan(X, f[t], g[t] - lb).rowwise() * dg.transpose();
+        dX -= W;
+        df -= W.rowwise().sum();
+
+        W = plan(X, f[t] - la, g[t - 1]).colwise() * df;
+        dX -= W;
+        dg = -W.colwise().sum().transpose();
+        df.setZero();
+    }
+
+    mat(dEdxi) += (dX / temperature).matrix();
+}
+
+DYNET_NODE_INST_DEV_IMPL(Sinkhorn)
+
+}
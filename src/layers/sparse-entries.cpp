@@ -0,0 +1,131 @@
+#include "layers/sparse-entries.h"
+#include <dynet/nodes-impl-macros.h>
+#include <dynet/tensor-eigen.h>
+
+namespace dynet {
+
+Expression
+gather_entries(const Expression& x, const std::vector<unsigned>& indices)
+{
+    return Expression(x.pg,
+                      x.pg->add_function<GatherEntries>({ x.i }, indices));
+}
+
+Expression
+scatter_entries(const Expression& u,
+                const std::vector<unsigned>& indices,
+                const Dim& d)
+{
+    return Expression(
+      u.pg, u.pg->add_function<ScatterEntries>({ u.i }, indices, d));
+}
+
+GatherEntries::GatherEntries(const std::initializer_list<VariableIndex>& a,
+                             const std::vector<unsigned>& indices)
+    : Node(a)
+    , indices(indices)
+{ }
+
+ScatterEntries::ScatterEntries(const std::initializer_list<VariableIndex>& a,
+                               const std::vector<unsigned>& indices,
+                               const Dim& d)
+    : Node(a)
+    , indices(indices)
+    , d(d)
+{ }
+
+std::string
+GatherEntries::as_string(const std::vector<std::string>& arg_names) const
+{
+    std::ostringstream s;
+    s << "gather-entries(";
+    for (auto&& arg_name : arg_names)
+        s << arg_name << ", ";
+    s << ")";
+    return s.str();
+}
+
+std::string
+ScatterEntries::as_string(const std::vector<std::string>& arg_names) const
+{
+    std::ostringstream s;
+    s << "scatter-entries(";
+    for (auto&& arg_name : arg_names)
+        s << arg_name << ", ";
+    s << ")";
+    return s.str();
+}
+
+Dim
+GatherEntries::dim_forward(const std::vector<Dim>&) const
+{
+    return { static_cast<unsigned>(indices.size()) };
+}
+
+Dim
+ScatterEntries::dim_forward(const std::vector<Dim>&) const
+{
+    return d;
+}
+
+template<class MyDevice>
+void
+GatherEntries::forward_dev_impl(const MyDevice&,
+                                const std::vector<const Tensor*>& xs,
+                                Tensor& fx) const
+{
+    auto x = vec(*xs[0]);
+    auto u = vec(fx);
+    for (size_t k = 0; k < indices.size(); ++k)
+        u(k) = x(indices[k]);
+}
+
+template<class MyDevice>
+void
+ScatterEntries::forward_dev_impl(const MyDevice&,
+                                 const std::vector<const Tensor*>& xs,
+                                 Tensor& fx) const
+{
+    auto u = vec(*xs[0]);
+    auto x = vec(fx);
+    x.setZero();
+    for (size_t k = 0; k < indices.size(); ++k)
+        x(indices[k]) = u(k);
+}
+
+template<class MyDevice>
+void
+GatherEntries::backward_dev_impl(const MyDevice&,
+                                 const std::vector<const Tensor*>&,
+                                 const Tensor&,
+                                 const Tensor& dEdf,
+                                 unsigned i,
+                                 Tensor& dEdxi) const
+{
+    assert(i == 0);
+    auto dE_du = vec(dEdf);
+    auto dE_dx = vec(dEdxi);
+    for (size_t k = 0; k < indices.size(); ++k)
+        dE_dx(indices[k]) += dE_du(k);
+}
+
+template<class MyDevice>
+void
+ScatterEntries::backward_dev_impl(const MyDevice&,
+                                  const std::vector<const Tensor*>&,
+                                  const Tensor&,
+                                  const Tensor& dEdf,
+                                  unsigned i,
+                                  Tensor& dEdxi) const
+{
+    assert(i == 0);
+    auto dE_dx = vec(dEdf);
+    auto dE_du = vec(dEdxi);
+    for (size_t k = 0; k < indices.size(); ++k)
+        dE_du(k) += dE_dx(indices[k]);
+}
+
+DYNET_NODE_INST_DEV_IMPL(GatherEntries)
+DYNET_NODE_INST_DEV_IMPL(ScatterEntries)
+
+}
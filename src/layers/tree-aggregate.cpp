@@ -0,0 +1,251 @@
+#include "layers/tree-aggregate.h"
+#include <dynet/nodes-impl-macros.h>
+#include <dynet/tensor-eigen.h>
+
+namespace dynet {
+
+Expression
+tree_parents(const Expression& X, const std::vector<unsigned>& heads)
+{
+    return Expression(X.pg,
+                      X.pg->add_function<TreeParents>(
+                        { X.i }, std::vector<std::vector<unsigned>>{ heads }));
+}
+
+Expression
+tree_children(const Expression& X, const std::vector<unsigned>& heads)
+{
+    return Expression(X.pg,
+                      X.pg->add_function<TreeChildren>(
+                        { X.i }, std::vector<std::vector<unsigned>>{ heads }));
+}
+
+Expression
+tree_parents(const Expression& X,
+             const std::vector<std::vector<unsigned>>& trees,
+             const Expression& w)
+{
+    return Expression(X.pg,
+                      X.pg->add_function<TreeParents>({ X.i, w.i }, trees));
+}
+
+Expression
+tree_children(const Expression& X,
+              const std::vector<std::vector<unsigned>>& trees,
+              const Expression& w)
+{
+    return Expression(X.pg,
+                      X.pg->add_function<TreeChildren>({ X.i, w.i }, trees));
+}
+
+TreeCSR::TreeCSR(const std::vector<unsigned>& heads)
+    : heads(heads)
+    , offset(heads.size() + 2, 0)
+    , child(heads.size())
+{
+    // counting sort of the nodes 1..n by head
+    for (auto h : heads)
+        offset[h + 1] += 1;
+    for (size_t h = 0; h + 1 < offset.size(); ++h)
+        offset[h + 1] += offset[h];
+
+    std::vector<unsigned> fill(offset.begin(), offset.end() - 1);
+    for (size_t m = 1; m <= heads.size(); ++m)
+        child[fill[heads[m - 1]]++] = m;
+}
+
+void
+TreeCSR::add_parents(unsigned d, float w, const float* X, unsigned ldx,
+                     float* Y, unsigned ldy) const
+{
+    for (size_t m = 1; m <= heads.size(); ++m) {
+        const float* x = X + ldx * heads[m - 1];
+        float* y = Y + ldy * m;
+        for (unsigned r = 0; r < d; ++r)
+            y[r] += w * x[r];
+    }
+}
+
+void
+TreeCSR::add_children(unsigned d, float w, const float* X, unsigned ldx,
+                      float* Y, unsigned ldy) const
+{
+    for (size_t h = 0; h + 1 < offset.size(); ++h) {
+        float* y = Y + ldy * h;
+        for (auto j = offset[h]; j < offset[h + 1]; ++j) {
+            const float* x = X + ldx * child[j];
+            for (unsigned r = 0; r < d; ++r)
+                y[r] += w * x[r];
+        }
+    }
+}
+
+float
+TreeCSR::dot_parents(unsigned d, const float* A, unsigned lda,
+                     const float* B, unsigned ldb) const
+{
+    float res = 0;
+    for (size_t m = 1; m <= heads.size(); ++m) {
+        const float* a = A + lda * m;
+        const float* b = B + ldb * heads[m - 1];
+        for (unsigned r = 0; r < d; ++r)
+            res += a[r] * b[r];
+    }
+    return res;
+}
+
+TreeParents::TreeParents(const std::initializer_list<VariableIndex>& a,
+                         const std::vector<std::vector<unsigned>>& trees)
+    : Node(a)
+    , trees(trees.begin(), trees.end())
+{ }
+
+TreeChildren::TreeChildren(const std::initializer_list<VariableIndex>& a,
+                           const std::vector<std::vector<unsigned>>& trees)
+    : Node(a)
+    , trees(trees.begin(), trees.end())
+{ }
+
+std::string
+TreeParents::as_string(const std::vector<std::string>& arg_names) const
+{
+    std::ostringstream s;
+    s << "tree-parents(";
+    for (auto&& arg_name : arg_names)
+        s << arg_name << ", ";
+    s << ")";
+    return s.str();
+}
+
+std::string
+TreeChildren::as_string(const std::vector<std::string>& arg_names) const
+{
+    std::ostringstream s;
+    s << "tree-children(";
+    for (auto&& arg_name : arg_names)
+        s << arg_name << ", ";
+    s << ")";
+    return s.str();
+}
+
+namespace {
+
+// X (d x (1 + n)) for every tree, and one weight per tree if weighted
+void
+check_tree_dims(const std::vector<Dim>& d,
+                const std::vector<TreeCSR>& trees,
+                const char* name)
+{
+    DYNET_ARG_CHECK(!trees.empty(), name << " needs at least one tree");
+    auto n = trees[0].heads.size();
+    for (auto& tree : trees)
+        DYNET_ARG_CHECK(tree.heads.size() == n,
+                        name << " expects trees of the same size");
+    DYNET_ARG_CHECK(d[0].nd == 2 && d[0][1] == n + 1 && d[0].bd == 1,
+                    name << " expects one d x (1 + n) matrix, got " << d[0]);
+    DYNET_ARG_CHECK(d.size() == 1 || (d[1].size() == trees.size()
+                                      && d[1].bd == 1),
+                    name << " expects one weight per tree, got " << d[1]);
+}
+
+}
+
+Dim
+TreeParents::dim_forward(const std::vector<Dim>& d) const
+{
+    check_tree_dims(d, trees, "tree-parents");
+    return d[0];
+}
+
+Dim
+TreeChildren::dim_forward(const std::vector<Dim>& d) const
+{
+    check_tree_dims(d, trees, "tree-children");
+    return d[0];
+}
+
+template<class MyDevice>
+void
+TreeParents::forward_dev_impl(const MyDevice&,
+                              const std::vector<const Tensor*>& xs,
+                              Tensor& fx) const
+{
+    unsigned d = xs[0]->d[0];
+
+    // the root has no head
+    TensorTools::zero(fx);
+    for (size_t k = 0; k < trees.size(); ++k) {
+        float w = xs.size() > 1 ? xs[1]->v[k] : 1;
+        trees[k].add_parents(d, w, xs[0]->v, d, fx.v, d);
+    }
+}
+
+template<class MyDevice>
+void
+TreeChildren::forward_dev_impl(const MyDevice&,
+                               const std::vector<const Tensor*>& xs,
+                               Tensor& fx) const
+{
+    unsigned d = xs[0]->d[0];
+
+    TensorTools::zero(fx);
+    for (size_t k = 0; k < trees.size(); ++k) {
+        float w = xs.size() > 1 ? xs[1]->v[k] : 1;
+        trees[k].add_children(d, w, xs[0]->v, d, fx.v, d);
+    }
+}
+
+template<class MyDevice>
+void
+TreeParents::backward_dev_impl(const MyDevice&,
+                               const std::vector<const Tensor*>& xs,
+                               const Tensor&,
+                               const Tensor& dEdf,
+                               unsigned i,
+                               Tensor& dEdxi) const
+{
+    unsigned d = xs[0]->d[0];
+
+    // <dE/dY, X G_k>
+    if (i == 1) {
+        for (size_t k = 0; k < trees.size(); ++k)
+            dEdxi.v[k] += trees[k].dot_parents(d, dEdf.v, d, xs[0]->v, d);
+        return;
+    }
+
+    // every head collects the gradients of its children
+    for (size_t k = 0; k < trees.size(); ++k) {
+        float w = xs.size() > 1 ? xs[1]->v[k] : 1;
+        trees[k].add_children(d, w, dEdf.v, d, dEdxi.v, d);
+    }
+}
+
+template<class MyDevice>
+void
+TreeChildren::backward_dev_impl(const MyDevice&,
+                                const std::vector<const Tensor*>& xs,
+                                const Tensor&,
+                                const Tensor& dEdf,
+                                unsigned i,
+                                Tensor& dEdxi) const
+{
+    unsigned d = xs[0]->d[0];
+
+    // <dE/dY, X G_k'> = <X, dE/dY G_k>
+    if (i == 1) {
+        for (size_t k = 0; k < trees.size(); ++k)
+            dEdxi.v[k] += trees[k].dot_parents(d, xs[0]->v, d, dEdf.v, d);
+        return;
+    }
+
+    // every child gets the gradient of its head
+    for (size_t k = 0; k < trees.size(); ++k) {
+        float w = xs.size() > 1 ? xs[1]->v[k] : 1;
+        trees[k].add_parents(d, w, dEdf.v, d, dEdxi.v, d);
+    }
+}
+
+DYNET_NODE_INST_DEV_IMPL(TreeParents)
+DYNET_NODE_INST_DEV_IMPL(TreeChildren)
+
+}
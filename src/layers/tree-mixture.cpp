@@ -0,0 +1,124 @@
+#include "layers/tree-mixture.h"
+#include <dynet/nodes-impl-macros.h>
+#include <dynet/tensor-eigen.h>
+
+#include <Eigen/Dense>
+
+#include "potentials.h"
+
+namespace dynet {
+
+TreeMixture
+tree_mixture(const Expression& eta_u,
+             AD3::GenericFactor& factor,
+             const std::vector<std::vector<int>>& index_arcs,
+             int max_iter)
+{
+    std::vector<double> eta, mu, mu_add;
+    to_double(eta_u.pg->incremental_forward(eta_u), eta);
+
+    factor.SetQPMaxIter(max_iter);
+    factor.SolveQP(eta, {}, &mu, &mu_add);
+
+    const auto& active_set = factor.GetQPActiveSet();
+    const auto& distribution = factor.GetQPDistribution();
+
+    TreeMixture res;
+    std::vector<std::vector<unsigned>> arcs;
+    std::vector<float> p;
+    for (size_t s = 0; s < active_set.size(); ++s) {
+        if (distribution[s] <= 0)
+            continue;
+        auto heads = static_cast<const std::vector<int>*>(active_set[s]);
+        std::vector<unsigned> tree, tree_arcs;
+        for (size_t m = 1; m < heads->size(); ++m) {
+            tree.push_back((*heads)[m]);
+            tree_arcs.push_back(index_arcs[(*heads)[m]][m]);
+        }
+        res.trees.push_back(tree);
+        arcs.push_back(tree_arcs);
+        p.push_back(distribution[s]);
+    }
+
+    auto* cg = eta_u.pg;
+    res.weights = Expression(
+      cg, cg->add_function<TreeMixtureWeights>({ eta_u.i }, arcs, p));
+    return res;
+}
+
+TreeMixtureWeights::TreeMixtureWeights(
+  const std::initializer_list<VariableIndex>& a,
+  const std::vector<std::vector<unsigned>>& arcs,
+  const std::vector<float>& p)
+    : Node(a)
+    , arcs(arcs)
+    , p(p)
+{
+    // Q[k, l]: arcs trees k and l have in common
+    size_t n_trees = arcs.size();
+    Eigen::MatrixXd Q(n_trees, n_trees);
+    for (size_t k = 0; k < n_trees; ++k)
+        for (size_t l = 0; l < n_trees; ++l) {
+            unsigned common = 0;
+            for (size_t m = 0; m < arcs[k].size(); ++m)
+                common += arcs[k][m] == arcs[l][m];
+            Q(k, l) = common;
+        }
+
+    Eigen::MatrixXd Q_inv = Q.inverse();
+    Eigen::VectorXd z = Q_inv * Eigen::VectorXd::Ones(n_trees);
+    Eigen::MatrixXd J = Q_inv - z * z.transpose() / z.sum();
+
+    jacobian.resize(n_trees * n_trees);
+    Eigen::Map<Eigen::MatrixXf>(jacobian.data(), n_trees, n_trees) =
+      J.cast<float>();
+}
+
+std::string
+TreeMixtureWeights::as_string(const std::vector<std::string>& arg_names) const
+{
+    std::ostringstream s;
+    s << "tree-mixture-weights(" << arg_names[0] << ")";
+    return s.str();
+}
+
+Dim
+TreeMixtureWeights::dim_forward(const std::vector<Dim>&) const
+{
+    return { static_cast<unsigned>(p.size()) };
+}
+
+template<class MyDevice>
+void
+TreeMixtureWeights::forward_dev_impl(const MyDevice&,
+                                     const std::vector<const Tensor*>&,
+                                     Tensor& fx) const
+{
+    // solved when the expression was built
+    std::copy(p.begin(), p.end(), fx.v);
+}
+
+template<class MyDevice>
+void
+TreeMixtureWeights::backward_dev_impl(const MyDevice&,
+                                      const std::vector<const Tensor*>&,
+                                      const Tensor&,
+                                      const Tensor& dEdf,
+                                      unsigned i,
+                                      Tensor& dEdxi) const
+{
+    assert(i == 0);
+    size_t n_trees = p.size();
+    Eigen::Map<const Eigen::MatrixXf> J(jacobian.data(), n_trees, n_trees);
+    Eigen::VectorXf v = J * vec(dEdf);
+
+    // M v: every tree adds its v to its arcs
+    auto dE_du = vec(dEdxi);
+    for (size_t k = 0; k < n_trees; ++k)
+        for (auto a : arcs[k])
+            dE_du(a) += v(k);
+}
+
+DYNET_NODE_INST_DEV_IMPL(TreeMixtureWeights)
+
+}
@@ -0,0 +1,82 @@
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "factors/BatchDependencyDecoder.h"
+#include "factors/DependencyDecoder.h"
+
+/* check the batched decoder against the one-sentence-at-a-time decoder */
+
+int
+main()
+{
+    std::mt19937 rng(42);
+    std::normal_distribution<float> normal;
+
+    std::vector<int> lengths = { 2, 7, 5, 12, 1, 9, 12, 3 };
+    int max_len = 12;
+    int batch_size = lengths.size();
+
+    std::vector<std::vector<float>> scores;
+    for (auto n : lengths) {
+        std::vector<float> s(n * n);
+        for (auto& x : s)
+            x = normal(rng);
+        scores.push_back(s);
+    }
+
+    BatchDependencyDecoder batch_decoder;
+    batch_decoder.reset(max_len, batch_size);
+    for (int b = 0; b < batch_size; ++b)
+        batch_decoder.set_scores(b, lengths[b], scores[b].data());
+
+    DependencyDecoder decoder;
+    int errors = 0;
+
+    for (bool projective : { true, false }) {
+        std::vector<std::vector<int>> heads;
+        std::vector<double> values;
+        if (projective)
+            batch_decoder.run_eisner(&heads, &values);
+        else
+            batch_decoder.run_chu_liu_edmonds(&heads, &values);
+
+        for (int b = 0; b < batch_size; ++b) {
+            int n = lengths[b];
+            if (n <= 1)
+                continue;
+
+            std::vector<std::vector<int>> index_arcs(n, std::vector<int>(n, -1));
+            std::vector<double> arc_scores;
+            for (int m = 1; m < n; ++m)
+                for (int h = 0; h < n; ++h)
+                    if (h != m) {
+                        index_arcs[h][m] = arc_scores.size();
+                        arc_scores.push_back(scores[b][m * n + h]);
+                    }
+
+            std::vector<int> expected;
+            double value;
+            if (projective)
+                decoder.RunEisner(n, arc_scores.size(), index_arcs, arc_scores,
+                                  &expected, &value);
+            else
+                decoder.RunChuLiuEdmonds(n, index_arcs, arc_scores, &expected,
+                                         &value);
+
+            std::cout << (projective ? "eisner " : "cle    ");
+            for (auto h : heads[b])
+                std::cout << h << " ";
+            std::cout << " (" << values[b] << " vs " << value << ")"
+                      << std::endl;
+
+            if (std::abs(values[b] - value) > 1e-4) {
+                std::cout << "mismatch in sentence " << b << std::endl;
+                ++errors;
+            }
+        }
+    }
+
+    return errors;
+}
@@ -0,0 +1,307 @@
+#include <dynet/dynet.h>
+#include <dynet/expr.h>
+#include <dynet/grad-check.h>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "builders/gcn.h"
+#include "layers/gcn-layer.h"
+
+namespace dy = dynet;
+
+
+dy::Expression
+dense_adj(dy::ComputationGraph& cg, const std::vector<unsigned>& heads)
+{
+    unsigned n = heads.size();
+    std::vector<float> data((1 + n) * (1 + n), 0.0f);
+    for (size_t i = 0; i < n; ++i)
+        data[(1 + n) * (1 + i) + heads[i]] = 1;
+    return dy::input(cg, { 1 + n, 1 + n }, data);
+}
+
+// Z_self + Z_parents G + Z_children G', unfused
+dy::Expression
+unfused_pre(const dy::Expression& Z, const dy::Expression& G, unsigned d)
+{
+    auto self = dy::pick_range(Z, 0, d);
+    auto parents = dy::pick_range(Z, d, 2 * d);
+    auto children = dy::pick_range(Z, 2 * d, 3 * d);
+    return self + parents * G + children * dy::transpose(G);
+}
+
+dy::Expression
+unfused(const dy::Expression& Z, const dy::Expression& G, unsigned d)
+{
+    return dy::rectify(unfused_pre(Z, G, d));
+}
+
+float
+max_abs_diff(const dy::Expression& a, const dy::Expression& b)
+{
+    auto va = dy::as_vector(a.value());
+    auto vb = dy::as_vector(b.value());
+    float res = 0;
+    for (size_t k = 0; k < va.size(); ++k)
+        res = std::max(res, std::abs(va[k] - vb[k]));
+    return res;
+}
+
+int
+check_close(const char* name, const dy::Expression& a, const dy::Expression& b)
+{
+    float diff = max_abs_diff(a, b);
+    std::cout << name << " " << diff << std::endl;
+    return diff > 1e-4 ? 1 : 0;
+}
+
+int test_gcn_layer(const std::vector<std::vector<unsigned>>& trees,
+                   unsigned dim)
+{
+    int errors = 0;
+    dy::ParameterCollection m;
+    unsigned n = trees[0].size();
+    unsigned k = trees.size();
+    auto Z_p = m.add_parameters({ 3 * dim, 1 + n }, 0, "Z");
+    auto G_p = m.add_parameters({ 1 + n, 1 + n }, 0, "G");
+    auto w_p = m.add_parameters({ k }, 0, "w");
+
+    {
+        dy::ComputationGraph cg;
+        auto Z = dy::parameter(cg, Z_p);
+        auto w = dy::parameter(cg, w_p);
+        auto G = dy::parameter(cg, G_p);
+
+        auto fused_dense = dy::gcn_layer(Z, G, 0);
+        auto fused_tree = dy::gcn_layer(Z, trees[0], 0);
+        auto fused_mixture = dy::gcn_layer(Z, trees, w, 0);
+        cg.forward(fused_dense + fused_tree + fused_mixture);
+
+        auto w_val = dy::as_vector(w.value());
+        auto G_mix = w_val[0] * dense_adj(cg, trees[0]);
+        for (unsigned t = 1; t < k; ++t)
+            G_mix = G_mix + w_val[t] * dense_adj(cg, trees[t]);
+
+        errors += check_close("dense vs unfused", fused_dense,
+                              unfused(Z, G, dim));
+        errors += check_close("tree vs unfused", fused_tree,
+                              unfused(Z, dense_adj(cg, trees[0]), dim));
+        errors += check_close("mixture vs unfused", fused_mixture,
+                              unfused(Z, G_mix, dim));
+    }
+
+    for (size_t i = 0; i < dim; ++i)
+        for (size_t j = 0; j <= n; ++j)
+        {
+            dy::ComputationGraph cg;
+            auto Z = dy::parameter(cg, Z_p);
+            auto w = dy::parameter(cg, w_p);
+            auto G = dy::parameter(cg, G_p);
+            auto Y = dy::gcn_layer(Z, G, 0)
+                   + dy::gcn_layer(Z, trees[0], 0)
+                   + dy::gcn_layer(Z, trees, w, 0);
+            auto z = dy::pick(dy::pick(Y, j, 1), i);
+            cg.backward(z);
+            if (!dy::check_grad(m, z, 1))
+                ++errors;
+        }
+    return errors;
+}
+
+// The mask is redrawn by every forward pass, so finite differences do not
+// apply: read it off the output, that must be relu(mask * pre) with mask
+// in {0, 1 / (1 - p)}, and check the gradient of sum(Y) against it.
+int test_gcn_layer_dropout(const std::vector<unsigned>& heads,
+                           unsigned dim,
+                           float p)
+{
+    int errors = 0;
+    dy::ParameterCollection m;
+    unsigned n = heads.size();
+    auto Z_p = m.add_parameters({ 3 * dim, 1 + n }, 0, "Z");
+
+    dy::ComputationGraph cg;
+    auto Z = dy::parameter(cg, Z_p);
+    auto Y = dy::gcn_layer(Z, heads, p);
+    auto pre = unfused_pre(Z, dense_adj(cg, heads), dim);
+    cg.forward(dy::sum_elems(Y) + dy::sum_elems(pre));
+
+    auto y = dy::as_vector(Y.value());
+    auto pre_val = dy::as_vector(pre.value());
+    std::vector<float> dP(y.size(), 0.0f);
+    unsigned kept = 0;
+    for (size_t k = 0; k < y.size(); ++k) {
+        if (y[k] == 0)
+            continue;
+        kept += 1;
+        dP[k] = 1 / (1 - p);
+        if (pre_val[k] <= 0 || std::abs(y[k] - pre_val[k] / (1 - p)) > 1e-4)
+            ++errors;
+    }
+
+    // dZ = [dP; dP G'; dP G]
+    cg.backward(dy::sum_elems(Y));
+    auto dZ = dy::as_vector(Z_p.get_storage().g);
+    std::vector<float> expected(dZ.size(), 0.0f);
+    auto at = [&](unsigned block, unsigned r, unsigned c) -> float& {
+        return expected[3 * dim * c + dim * block + r];
+    };
+    for (unsigned r = 0; r < dim; ++r) {
+        for (unsigned c = 0; c <= n; ++c)
+            at(0, r, c) = dP[dim * c + r];
+        for (unsigned c = 1; c <= n; ++c) {
+            at(1, r, heads[c - 1]) += dP[dim * c + r];
+            at(2, r, c) += dP[dim * heads[c - 1] + r];
+        }
+    }
+    float diff = 0;
+    for (size_t k = 0; k < dZ.size(); ++k)
+        diff = std::max(diff, std::abs(dZ[k] - expected[k]));
+    if (diff > 1e-4)
+        ++errors;
+
+    std::cout << "dropout " << p << ": kept " << kept << "/" << y.size()
+              << ", gradient " << diff << std::endl;
+    return errors;
+}
+
+// two trees side by side vs each on its own
+int test_block_diagonal(const std::vector<unsigned>& heads_a,
+                        const std::vector<unsigned>& heads_b,
+                        unsigned dim)
+{
+    int errors = 0;
+    dy::ParameterCollection m;
+    unsigned n_a = 1 + heads_a.size(), n_b = 1 + heads_b.size();
+    auto Z_p = m.add_parameters({ 3 * dim, n_a + n_b }, 0, "Z");
+    auto w_p = m.add_parameters({ 2 }, 0, "w");
+
+    {
+        dy::ComputationGraph cg;
+        auto Z = dy::parameter(cg, Z_p);
+        auto w = dy::parameter(cg, w_p);
+        auto Y = dy::gcn_layer(Z, { heads_a, heads_b }, { 0, n_a }, w, 0);
+        auto Y_a = dy::gcn_layer(dy::pick_range(Z, 0, n_a, 1),
+                                 { heads_a }, dy::pick(w, 0u), 0);
+        auto Y_b = dy::gcn_layer(dy::pick_range(Z, n_a, n_a + n_b, 1),
+                                 { heads_b }, dy::pick(w, 1u), 0);
+        cg.forward(dy::sum_elems(Y) + dy::sum_elems(Y_a)
+                   + dy::sum_elems(Y_b));
+
+        errors += check_close("block-diagonal vs separate", Y,
+                              dy::concatenate_cols({ Y_a, Y_b }));
+    }
+
+    for (size_t i = 0; i < dim; ++i)
+        for (size_t j = 0; j < n_a + n_b; ++j)
+        {
+            dy::ComputationGraph cg;
+            auto Z = dy::parameter(cg, Z_p);
+            auto w = dy::parameter(cg, w_p);
+            auto Y = dy::gcn_layer(Z, { heads_a, heads_b }, { 0, n_a }, w, 0);
+            auto z = dy::pick(dy::pick(Y, j, 1), i);
+            cg.backward(z);
+            if (!dy::check_grad(m, z, 1))
+                ++errors;
+        }
+    return errors;
+}
+
+enum class GraphKind { Tree, Mixture, Mixed };
+
+// GCNBuilder::apply_batch vs apply on each sentence, batched or not
+int test_apply_batch(GraphKind kind, bool dense)
+{
+    int errors = 0;
+    const std::vector<std::vector<unsigned>> heads{ { 2, 0, 2, 3 },
+                                                    { 0, 1, 1 },
+                                                    { 0 } };
+    unsigned dim_in = 3, dim_out = 2;
+
+    dy::ParameterCollection m;
+    GCNBuilder gcn(m, 2, dim_in, dim_out, dense);
+    std::vector<dy::Parameter> X_p;
+    for (auto& h : heads)
+        X_p.push_back(m.add_parameters(
+          { dim_in, 1 + static_cast<unsigned>(h.size()) }, 0, "X"));
+    auto w_p = m.add_parameters({ 2 * static_cast<unsigned>(heads.size()) },
+                                0, "w");
+
+    auto run = [&](dy::ComputationGraph& cg, bool batched) {
+        gcn.new_graph(cg, false);
+        auto w = dy::parameter(cg, w_p);
+        std::vector<dy::Expression> Xs;
+        std::vector<GCNGraph> graphs;
+        for (size_t s = 0; s < heads.size(); ++s) {
+            Xs.push_back(dy::parameter(cg, X_p[s]));
+            // a flat tree is the second tree of every mixture
+            std::vector<unsigned> flat(heads[s].size(), 0);
+            if (kind == GraphKind::Tree)
+                graphs.emplace_back(heads[s]);
+            else if (kind == GraphKind::Mixed && s == 1)
+                graphs.emplace_back(dense_adj(cg, heads[s]));
+            else
+                graphs.emplace_back(
+                  std::vector<std::vector<unsigned>>{ heads[s], flat },
+                  dy::pick_range(w, 2 * s, 2 * s + 2));
+        }
+        if (batched)
+            return gcn.apply_batch(Xs, graphs);
+        std::vector<dy::Expression> res;
+        for (size_t s = 0; s < heads.size(); ++s)
+            res.push_back(gcn.apply(Xs[s], graphs[s]));
+        return res;
+    };
+
+    {
+        dy::ComputationGraph cg;
+        auto batched = run(cg, true);
+        auto separate = run(cg, false);
+        cg.forward(dy::sum_elems(dy::concatenate_cols(batched))
+                   + dy::sum_elems(dy::concatenate_cols(separate)));
+        for (size_t s = 0; s < heads.size(); ++s)
+            errors += check_close("apply_batch vs apply", batched[s],
+                                  separate[s]);
+    }
+
+    {
+        dy::ComputationGraph cg;
+        auto batched = run(cg, true);
+        std::vector<dy::Expression> sums;
+        for (size_t s = 0; s < batched.size(); ++s)
+            sums.push_back((1.0f + s) * dy::sum_elems(batched[s]));
+        auto z = dy::sum(sums);
+        cg.backward(z);
+        if (!dy::check_grad(m, z, 1))
+            ++errors;
+    }
+    return errors;
+}
+
+
+int main(int argc, char** argv)
+{
+    dy::initialize(argc, argv);
+
+    int errors = 0;
+    std::cout << "single tree" << std::endl;
+    errors += test_gcn_layer({ { 2, 0, 2, 3, 3, 2 } }, 3);
+    std::cout << "mixture" << std::endl;
+    errors += test_gcn_layer({ { 2, 0, 2, 3, 3, 2 },
+                               { 0, 0, 0, 0, 0, 0 },
+                               { 2, 3, 4, 5, 6, 0 } }, 3);
+    std::cout << "dropout" << std::endl;
+    errors += test_gcn_layer_dropout({ 2, 0, 2, 3, 3, 2 }, 4, 0.5);
+    std::cout << "block-diagonal" << std::endl;
+    errors += test_block_diagonal({ 2, 0, 2, 3 }, { 0, 1, 1 }, 3);
+    for (bool dense : { false, true }) {
+        std::cout << "apply_batch, dense " << dense << std::endl;
+        errors += test_apply_batch(GraphKind::Tree, dense);
+        errors += test_apply_batch(GraphKind::Mixture, dense);
+        errors += test_apply_batch(GraphKind::Mixed, dense);
+    }
+    std::cout << errors << " errors" << std::endl;
+    return errors;
+}
@@ -0,0 +1,68 @@
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "factors/FactorLabelTree.h"
+
+/* check the label tree DP of FactorLabelTree against brute force */
+
+std::mt19937 rng(42);
+
+int
+main()
+{
+    std::normal_distribution<double> normal;
+    int errors = 0;
+
+    for (int n_labels = 1; n_labels <= 10; ++n_labels) {
+        for (int rep = 0; rep < 20; ++rep) {
+            // random forest: each label hangs from an earlier one, or not
+            std::vector<int> parents(n_labels, -1);
+            std::uniform_int_distribution<int> coin(0, 3);
+            for (int l = 1; l < n_labels; ++l) {
+                if (coin(rng) > 0)
+                    parents[l] = std::uniform_int_distribution<int>(
+                      0, l - 1)(rng);
+            }
+
+            sparsemap::FactorLabelTree f;
+            f.Initialize(parents);
+
+            std::vector<double> eta_u(n_labels);
+            std::vector<double> eta_v(f.GetNumAdditionals());
+            for (auto& u : eta_u)
+                u = normal(rng);
+            for (auto& v : eta_v)
+                v = 2 * normal(rng);
+
+            auto cfg = f.CreateConfiguration();
+            double value, check_value;
+            f.Maximize(eta_u, eta_v, cfg, &value);
+            f.Evaluate(eta_u, eta_v, cfg, &check_value);
+
+            auto y = static_cast<std::vector<int>*>(cfg);
+            double best = -std::numeric_limits<double>::infinity();
+            for (int bits = 0; bits < (1 << n_labels); ++bits) {
+                for (int l = 0; l < n_labels; ++l)
+                    (*y)[l] = (bits >> l) & 1;
+                double val;
+                f.Evaluate(eta_u, eta_v, cfg, &val);
+                best = std::max(best, val);
+            }
+            f.DeleteConfiguration(cfg);
+
+            if (std::abs(value - best) > 1e-9
+                || std::abs(check_value - best) > 1e-9) {
+                std::cout << n_labels << " labels: got " << value << " ("
+                          << check_value << "), expected " << best
+                          << std::endl;
+                ++errors;
+            }
+        }
+    }
+
+    std::cout << errors << " errors" << std::endl;
+    return errors;
+}
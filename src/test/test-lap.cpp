@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "factors/FactorMatching.h"
+#include "lapjv.h"
+
+/* check the LAP solvers against brute force on small random problems */
+
+double
+assignment_cost(const std::vector<std::vector<double>>& cost,
+                const std::vector<int>& x)
+{
+    double total = 0;
+    for (size_t i = 0; i < x.size(); ++i)
+        total += cost[i][x[i]];
+    return total;
+}
+
+double
+brute_force(const std::vector<std::vector<double>>& cost)
+{
+    std::vector<int> perm(cost.size());
+    std::iota(perm.begin(), perm.end(), 0);
+    double best = assignment_cost(cost, perm);
+    while (std::next_permutation(perm.begin(), perm.end()))
+        best = std::min(best, assignment_cost(cost, perm));
+    return best;
+}
+
+std::vector<double*>
+row_pointers(std::vector<std::vector<double>>& cost)
+{
+    std::vector<double*> ptr;
+    for (auto& row : cost)
+        ptr.push_back(row.data());
+    return ptr;
+}
+
+// best value among the partial matchings of largest cardinality
+double
+brute_force_sparse(const std::vector<std::vector<int>>& allowed,
+                   const std::vector<double>& eta,
+                   int cols)
+{
+    int rows = allowed.size();
+    int best_card = -1;
+    double best = 0;
+    std::vector<bool> used(cols, false);
+
+    std::function<void(int, int, int, double)> search =
+      [&](int i, int k, int card, double val) {
+          if (i == rows) {
+              if (card > best_card || (card == best_card && val > best)) {
+                  best_card = card;
+                  best = val;
+              }
+              return;
+          }
+          search(i + 1, k + allowed[i].size(), card, val);
+          for (size_t r = 0; r < allowed[i].size(); ++r) {
+              int j = allowed[i][r];
+              if (used[j])
+                  continue;
+              used[j] = true;
+              search(i + 1, k + allowed[i].size(), card + 1, val + eta[k + r]);
+              used[j] = false;
+          }
+      };
+    search(0, 0, 0, 0);
+    return best;
+}
+
+int
+check_sparse_matching(std::mt19937& rng)
+{
+    std::normal_distribution<double> normal;
+    std::bernoulli_distribution coin(.5);
+    int errors = 0;
+
+    for (int trial = 0; trial < 100; ++trial) {
+        int rows = 1 + trial % 4, cols = 1 + (trial / 4) % 6;
+        std::vector<std::vector<int>> allowed(rows);
+        std::vector<double> eta, additional;
+        for (auto& row : allowed)
+            for (int j = 0; j < cols; ++j)
+                if (coin(rng)) {
+                    row.push_back(j);
+                    eta.push_back(normal(rng));
+                }
+
+        sparsemap::FactorMatching f;
+        f.Initialize(rows, cols, allowed);
+        auto cfg = f.CreateConfiguration();
+        double value;
+        f.Maximize(eta, additional, cfg, &value);
+        f.DeleteConfiguration(cfg);
+
+        if (std::abs(value - brute_force_sparse(allowed, eta, cols)) > 1e-9) {
+            std::cout << "sparse matching: wrong value, " << rows << "x"
+                      << cols << std::endl;
+            ++errors;
+        }
+    }
+    return errors;
+}
+
+// with fewer rows than columns, every row is matched (as a XOR per row
+// and at most one per column)
+int
+check_rectangular_matching(std::mt19937& rng)
+{
+    std::normal_distribution<double> normal;
+    int errors = 0;
+
+    for (int rows = 1; rows <= 4; ++rows)
+        for (int cols = rows; cols <= 6; ++cols) {
+            std::vector<std::vector<int>> all(rows);
+            for (auto& row : all)
+                for (int j = 0; j < cols; ++j)
+                    row.push_back(j);
+            std::vector<double> eta(rows * cols), additional;
+            for (auto& e : eta)
+                e = normal(rng);
+
+            sparsemap::FactorMatching f;
+            f.Initialize(rows, cols);
+            auto cfg = f.CreateConfiguration();
+            double value;
+            f.Maximize(eta, additional, cfg, &value);
+            auto assigned = static_cast<std::vector<int>*>(cfg);
+            bool all_matched =
+              std::find(assigned->begin(), assigned->end(), -1) ==
+              assigned->end();
+            f.DeleteConfiguration(cfg);
+
+            if (!all_matched ||
+                std::abs(value - brute_force_sparse(all, eta, cols)) > 1e-9) {
+                std::cout << "rectangular matching: wrong value, " << rows
+                          << "x" << cols << std::endl;
+                ++errors;
+            }
+        }
+    return errors;
+}
+
+// repeated auction solves of rectangular problems, as in SparseMAP: each
+// must stay cheap, and within max(rows, cols) * eps of the best matching
+int
+check_repeated_auction(std::mt19937& rng)
+{
+    std::normal_distribution<double> normal;
+    int errors = 0;
+
+    struct Shape { int rows, cols; double eps; };
+    for (auto shape : { Shape{ 11, 3, 1e-8 }, Shape{ 3, 11, 1e-8 },
+                        Shape{ 20, 30, 1e-6 } }) {
+        int rows = shape.rows, cols = shape.cols;
+        std::vector<std::vector<int>> all(rows);
+        for (auto& row : all)
+            for (int j = 0; j < cols; ++j)
+                row.push_back(j);
+        std::vector<double> eta(rows * cols), additional;
+
+        sparsemap::FactorMatching f;
+        f.Initialize(rows, cols);
+        f.SetAuction(shape.eps);
+        auto cfg = f.CreateConfiguration();
+        auto start = std::chrono::steady_clock::now();
+        for (int rep = 0; rep < 10; ++rep) {
+            for (auto& e : eta)
+                e = normal(rng);
+            double value;
+            f.Maximize(eta, additional, cfg, &value);
+            if (rows * cols <= 40
+                && brute_force_sparse(all, eta, cols) - value
+                     > std::max(rows, cols) * shape.eps + 1e-9) {
+                std::cout << "repeated auction: wrong value, " << rows << "x"
+                          << cols << std::endl;
+                ++errors;
+            }
+        }
+        f.DeleteConfiguration(cfg);
+
+        // a few ms at most; stale prices used to take seconds per solve
+        std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+        if (elapsed.count() > 0.5) {
+            std::cout << "repeated auction: " << elapsed.count() << "s, "
+                      << rows << "x" << cols << std::endl;
+            ++errors;
+        }
+    }
+    return errors;
+}
+
+// many problems of various sizes at once, against one at a time
+int
+check_batch(std::mt19937& rng)
+{
+    std::normal_distribution<double> normal;
+    int n_problems = 50, errors = 0;
+
+    std::vector<uint_t> sizes;
+    std::vector<std::vector<std::vector<double>>> costs;
+    std::vector<std::vector<double*>> rows;
+    std::vector<std::vector<int>> x, y;
+    std::vector<std::vector<double>> v;
+    for (int p = 0; p < n_problems; ++p) {
+        int n = 1 + (p * 7) % 60;
+        sizes.push_back(n);
+        costs.emplace_back(n, std::vector<double>(n));
+        for (auto& row : costs.back())
+            for (auto& c : row)
+                c = normal(rng);
+        x.emplace_back(n);
+        y.emplace_back(n);
+        v.emplace_back(n);
+    }
+
+    std::vector<double**> c_ptr;
+    std::vector<int*> x_ptr, y_ptr;
+    std::vector<double*> v_ptr;
+    for (int p = 0; p < n_problems; ++p) {
+        rows.push_back(row_pointers(costs[p]));
+        c_ptr.push_back(rows[p].data());
+        x_ptr.push_back(x[p].data());
+        y_ptr.push_back(y[p].data());
+        v_ptr.push_back(v[p].data());
+    }
+
+    for (uint_t n_threads : { 1u, 4u, 0u }) {
+        if (lapjv_batch<double>(n_problems, sizes.data(), c_ptr.data(),
+                                x_ptr.data(), y_ptr.data(), v_ptr.data(),
+                                n_threads) != 0) {
+            std::cout << "lapjv_batch: failed" << std::endl;
+            ++errors;
+        }
+        for (int p = 0; p < n_problems; ++p) {
+            std::vector<int> x1(sizes[p]), y1(sizes[p]);
+            lapjv_internal(sizes[p], rows[p].data(), x1.data(), y1.data());
+            double expected = assignment_cost(costs[p], x1);
+            if (std::abs(assignment_cost(costs[p], x[p]) - expected) > 1e-9) {
+                std::cout << "lapjv_batch: wrong cost, n=" << sizes[p]
+                          << std::endl;
+                ++errors;
+            }
+        }
+    }
+    return errors;
+}
+
+int
+main()
+{
+    std::mt19937 rng(42);
+    std::normal_distribution<double> normal;
+
+    std::cout << "lapjv kernels: " << lapjv_simd() << std::endl;
+
+    int errors = 0;
+    lapjv_workspace_t ws = { 0, 0, 0, 0, 0, 0 };
+
+    for (int trial = 0; trial < 200; ++trial) {
+        int n = 1 + trial % 7;
+        if (trial % 10 == 9)
+            n = 9; // longer than most vector widths
+        std::vector<std::vector<double>> cost(n, std::vector<double>(n));
+        for (auto& row : cost)
+            for (auto& c : row)
+                c = normal(rng);
+
+        auto ptr = row_pointers(cost);
+        std::vector<int> x(n), y(n);
+        std::vector<double> v(n);
+
+        double expected = brute_force(cost);
+
+        lapjv_internal(n, ptr.data(), x.data(), y.data());
+        if (std::abs(assignment_cost(cost, x) - expected) > 1e-9) {
+            std::cout << "lapjv_internal: wrong cost, n=" << n << std::endl;
+            ++errors;
+        }
+
+        // single precision
+        std::vector<std::vector<float>> cost_f(n);
+        std::vector<float*> ptr_f;
+        for (int i = 0; i < n; ++i) {
+            cost_f[i].assign(cost[i].begin(), cost[i].end());
+            ptr_f.push_back(cost_f[i].data());
+        }
+        lapjv_internal(n, ptr_f.data(), x.data(), y.data());
+        if (std::abs(assignment_cost(cost, x) - expected) > 1e-4) {
+            std::cout << "lapjv_internal (float): wrong cost, n=" << n
+                      << std::endl;
+            ++errors;
+        }
+
+        // auction, to within n * eps of the optimum
+        const double eps = 1e-6;
+        auction_warm(n, ptr.data(), x.data(), y.data(), v.data(), eps, FALSE,
+                     &ws);
+        if (assignment_cost(cost, x) - expected > n * eps + 1e-9) {
+            std::cout << "auction_warm: wrong cost, n=" << n << std::endl;
+            ++errors;
+        }
+
+        // cold, then warm-started on perturbed costs
+        lapjv_warm(n, ptr.data(), x.data(), y.data(), v.data(), FALSE, &ws);
+        for (auto& row : cost)
+            for (auto& c : row)
+                c += 0.1 * normal(rng);
+        expected = brute_force(cost);
+        lapjv_warm(n, ptr.data(), x.data(), y.data(), v.data(), TRUE, &ws);
+        if (std::abs(assignment_cost(cost, x) - expected) > 1e-9) {
+            std::cout << "lapjv_warm: wrong cost, n=" << n << std::endl;
+            ++errors;
+        }
+        auction_warm(n, ptr.data(), x.data(), y.data(), v.data(), eps, TRUE,
+                     &ws);
+        if (assignment_cost(cost, x) - expected > n * eps + 1e-9) {
+            std::cout << "auction_warm (warm): wrong cost, n=" << n
+                      << std::endl;
+            ++errors;
+        }
+    }
+
+    lapjv_workspace_free(&ws);
+    errors += check_sparse_matching(rng);
+    errors += check_rectangular_matching(rng);
+    errors += check_repeated_auction(rng);
+    errors += check_batch(rng);
+    std::cout << errors << " errors" << std::endl;
+    return errors;
+}
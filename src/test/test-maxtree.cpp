@@ -1,9 +1,94 @@
+#include <cmath>
+#include <iostream>
 #include <vector>
 
 #include <ad3/FactorGraph.h>
-#include "factors/FactorTreeTurbo.h"
+#include "factors/TreeFactor.h"
 
 
+// heads[m] for m >= 1 is a projective tree with a single root word
+bool
+is_projective_tree(const std::vector<int>& heads)
+{
+    int n = heads.size(), roots = 0;
+    for (int m = 1; m < n; ++m) {
+        roots += heads[m] == 0;
+        int h = m;
+        for (int steps = 0; h != 0 && steps < n; ++steps)
+            h = heads[h];
+        if (h != 0)
+            return false;
+    }
+    for (int m1 = 1; m1 < n; ++m1)
+        for (int m2 = 1; m2 < n; ++m2) {
+            int l1 = std::min(heads[m1], m1), r1 = std::max(heads[m1], m1);
+            int l2 = std::min(heads[m2], m2), r2 = std::max(heads[m2], m2);
+            if (l1 < l2 && l2 < r1 && r1 < r2)
+                return false;
+        }
+    return roots == 1;
+}
+
+bool
+is_chain(const std::vector<int>& heads)
+{
+    std::vector<int> modifiers(heads.size(), 0);
+    for (size_t m = 1; m < heads.size(); ++m)
+        if (++modifiers[heads[m]] > 1)
+            return false;
+    return true;
+}
+
+// at most one modifier per word: the best tree must be a chain whose
+// score is the reported value (exactness is checked in test-tree-factor)
+int
+test_valency_chain(int sz)
+{
+    std::vector<std::tuple<int, int>> arcs;
+    std::vector<double> scores;
+    int k = 1;
+    for (int m = 1; m < sz; ++m)
+        for (int h = 0; h < sz; ++h)
+            if (h != m) {
+                arcs.push_back(std::make_tuple(h, m));
+                // favour bushy trees, so that the limit matters
+                scores.push_back(h == 0 ? 0.5 + k : std::sin(k));
+                ++k;
+            }
+
+    auto fg = std::make_unique<AD3::FactorGraph>();
+    std::vector<AD3::BinaryVariable*> vars;
+    for (size_t i = 0; i < arcs.size(); ++i)
+        vars.push_back(fg->CreateBinaryVariable());
+    auto* valency_factor = new AD3::FactorTreeValency;
+    fg->DeclareFactor(static_cast<AD3::Factor*>(valency_factor), vars,
+                      /*pass_ownership=*/true);
+    valency_factor->Initialize(
+      sz, arcs, AD3::EisnerValencyDecoder{ /*max_valency=*/1 });
+
+    auto cfg = valency_factor->CreateConfiguration();
+    double value = 0;
+    valency_factor->Maximize(scores, {}, cfg, &value);
+    auto heads = *static_cast<std::vector<int>*>(cfg);
+    valency_factor->DeleteConfiguration(cfg);
+
+    double score = 0;
+    for (size_t r = 0; r < arcs.size(); ++r)
+        if (heads[std::get<1>(arcs[r])] == std::get<0>(arcs[r]))
+            score += scores[r];
+
+    if (!is_projective_tree(heads) || !is_chain(heads)
+        || std::abs(value - score) > 1e-9) {
+        std::cout << "valency (" << sz << "): got " << value
+                  << ", heads scored " << score << ":";
+        for (auto h : heads)
+            std::cout << " " << h;
+        std::cout << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char** argv)
 {
     auto fg = std::make_unique<AD3::FactorGraph>();
@@ -35,9 +120,17 @@ int main(int argc, char** argv)
        std::cout << s << " ";
     std::cout << std::endl;
 
-    auto* tree_factor = new AD3::FactorTreeTurbo;
+    AD3::GenericFactor* tree_factor;
+    if (projective) {
+        auto* eisner = new AD3::FactorTreeProjective;
+        eisner->Initialize(sz, arcs);
+        tree_factor = eisner;
+    } else {
+        auto* cle = new AD3::FactorTree;
+        cle->Initialize(sz, arcs);
+        tree_factor = cle;
+    }
     fg->DeclareFactor(static_cast<AD3::Factor*>(tree_factor), vars, /*pass_ownership=*/true);
-    tree_factor->Initialize(projective, sz, arcs);
     auto cfg = tree_factor->CreateConfiguration();
     double value = 0;
     tree_factor->Maximize(scores, add, cfg, &value);
@@ -47,7 +140,13 @@ int main(int argc, char** argv)
         std::cout << i << " ";
     std::cout << std::endl;
 
-    return 0;
+    tree_factor->DeleteConfiguration(cfg);
+
+    int errors = 0;
+    for (int valency_sz = 2; valency_sz <= 6; ++valency_sz)
+        errors += test_valency_chain(valency_sz);
+    std::cout << errors << " errors" << std::endl;
+    return errors;
 }
 
 
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "factors/FactorPairBundle.h"
+
+/* check the closed-form pair solutions of FactorPairBundle against
+ * enumeration (MAP), projected gradient (QP) and finite differences */
+
+std::mt19937 rng(42);
+
+// configurations 00, 10, 01, 11 of one pair
+const double x1s[] = { 0, 1, 0, 1 };
+const double x2s[] = { 0, 0, 1, 1 };
+
+// project p onto the probability simplex
+void
+project_simplex(std::vector<double>& p)
+{
+    std::vector<double> s = p;
+    std::sort(s.rbegin(), s.rend());
+    double cum = 0, tau = 0;
+    for (size_t k = 0; k < s.size(); ++k) {
+        cum += s[k];
+        double t = (cum - 1) / (k + 1);
+        if (s[k] - t > 0)
+            tau = t;
+    }
+    for (auto& v : p)
+        v = std::max(0.0, v - tau);
+}
+
+// min 1/2 |mu - u|^2 - w mu12 over distributions on the four configurations
+void
+pair_qp(double u1, double u2, double w, double* a, double* b, double* ab)
+{
+    std::vector<double> p(4, .25);
+    for (int it = 0; it < 20000; ++it) {
+        double m1 = p[1] + p[3], m2 = p[2] + p[3];
+        for (int c = 0; c < 4; ++c)
+            p[c] -= .1 * ((m1 - u1) * x1s[c] + (m2 - u2) * x2s[c]
+                          - w * x1s[c] * x2s[c]);
+        project_simplex(p);
+    }
+    *a = p[1] + p[3];
+    *b = p[2] + p[3];
+    *ab = p[3];
+}
+
+int
+main()
+{
+    std::normal_distribution<double> normal;
+    int errors = 0;
+
+    // pairs in two tied groups, reusing variables across pairs
+    int n_pairs = 200;
+    std::vector<int> group(n_pairs);
+    for (int k = 0; k < n_pairs; ++k)
+        group[k] = k % 3 == 0;
+
+    sparsemap::FactorPairBundle bundle;
+    bundle.Initialize(group, 2);
+
+    for (double w : { 1.5, -.7, .2 }) {
+        std::vector<double> eta_u(2 * n_pairs), eta_v = { w, -w / 2 };
+        for (auto& u : eta_u)
+            u = normal(rng);
+
+        std::vector<double> mu, mu_v;
+        double value;
+        bundle.SolveMAP(eta_u, eta_v, &mu, &mu_v, &value);
+        double check_value;
+        bundle.Evaluate(eta_u, eta_v, mu, &check_value);
+        if (std::abs(value - check_value) > 1e-9)
+            ++errors;
+
+        for (int k = 0; k < n_pairs; ++k) {
+            double u1 = eta_u[2 * k], u2 = eta_u[2 * k + 1];
+            double wk = eta_v[group[k]];
+            double best = 0;
+            for (int c = 0; c < 4; ++c)
+                best = std::max(best,
+                                x1s[c] * u1 + x2s[c] * u2
+                                  + x1s[c] * x2s[c] * wk);
+            double got = mu[2 * k] * u1 + mu[2 * k + 1] * u2
+                         + mu[2 * k] * mu[2 * k + 1] * wk;
+            if (std::abs(got - best) > 1e-9) {
+                std::cout << "map " << k << ": " << got << " vs " << best
+                          << std::endl;
+                ++errors;
+            }
+        }
+
+        bundle.SolveQP(eta_u, eta_v, &mu, &mu_v);
+        std::vector<double> expected_v(2, 0);
+        for (int k = 0; k < n_pairs; ++k) {
+            double a, b, ab;
+            pair_qp(eta_u[2 * k], eta_u[2 * k + 1], eta_v[group[k]],
+                    &a, &b, &ab);
+            expected_v[group[k]] += ab;
+            if (std::abs(a - mu[2 * k]) > 1e-6
+                || std::abs(b - mu[2 * k + 1]) > 1e-6) {
+                std::cout << "qp " << k << ": (" << mu[2 * k] << ", "
+                          << mu[2 * k + 1] << ") vs (" << a << ", " << b
+                          << ")" << std::endl;
+                ++errors;
+            }
+        }
+        for (int g = 0; g < 2; ++g)
+            if (std::abs(mu_v[g] - expected_v[g]) > 1e-4)
+                ++errors;
+
+        // Jacobian-vector products against central differences
+        std::vector<double> v(2 * n_pairs), out, out_v;
+        for (auto& x : v)
+            x = normal(rng);
+        bundle.JacobianVec(v, out, out_v);
+
+        double h = 1e-6;
+        auto directional = [&](std::vector<double> du,
+                               std::vector<double> dv) {
+            std::vector<double> up_u = eta_u, dn_u = eta_u;
+            std::vector<double> up_v = eta_v, dn_v = eta_v;
+            for (size_t i = 0; i < du.size(); ++i) {
+                up_u[i] += h * du[i];
+                dn_u[i] -= h * du[i];
+            }
+            for (size_t g = 0; g < dv.size(); ++g) {
+                up_v[g] += h * dv[g];
+                dn_v[g] -= h * dv[g];
+            }
+            std::vector<double> mu_up, mu_dn, add;
+            bundle.SolveQP(up_u, up_v, &mu_up, &add);
+            bundle.SolveQP(dn_u, dn_v, &mu_dn, &add);
+            double d = 0;
+            for (size_t i = 0; i < v.size(); ++i)
+                d += v[i] * (mu_up[i] - mu_dn[i]) / (2 * h);
+            return d;
+        };
+
+        // <v, J e_i> for a few i, and <v, d mu / d eta_v[g]>
+        for (int i = 0; i < 2 * n_pairs; i += 7) {
+            std::vector<double> e(2 * n_pairs, 0);
+            e[i] = 1;
+            double fd = directional(e, { 0, 0 });
+            if (std::abs(fd - out[i]) > 1e-5) {
+                std::cout << "jac " << i << ": " << out[i] << " vs " << fd
+                          << std::endl;
+                ++errors;
+            }
+        }
+        for (int g = 0; g < 2; ++g) {
+            std::vector<double> e(2, 0);
+            e[g] = 1;
+            double fd = directional(std::vector<double>(2 * n_pairs, 0), e);
+            if (std::abs(fd - out_v[g]) > 1e-5) {
+                std::cout << "jac_v " << g << ": " << out_v[g] << " vs "
+                          << fd << std::endl;
+                ++errors;
+            }
+        }
+    }
+
+    std::cout << errors << " errors" << std::endl;
+    return errors;
+}
@@ -0,0 +1,113 @@
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "factors/FactorSequence.h"
+#include "factors/FactorSequenceDistance.h"
+
+/* check Viterbi decoding of the sequence factors against brute force */
+
+std::mt19937 rng(42);
+
+std::vector<double>
+random_vector(size_t n)
+{
+    std::normal_distribution<double> normal;
+    std::vector<double> x(n);
+    for (auto& v : x)
+        v = normal(rng);
+    return x;
+}
+
+// best score over all state sequences
+double
+brute_force(sparsemap::FactorSequence& f,
+            const std::vector<int>& num_states,
+            const std::vector<double>& eta_u,
+            const std::vector<double>& eta_v)
+{
+    int length = num_states.size();
+    auto cfg = f.CreateConfiguration();
+    auto seq = static_cast<std::vector<int>*>(cfg);
+    double best = -std::numeric_limits<double>::infinity();
+
+    std::function<void(int)> search = [&](int i) {
+        if (i == length) {
+            double val;
+            f.Evaluate(eta_u, eta_v, cfg, &val);
+            best = std::max(best, val);
+            return;
+        }
+        for (int k = 0; k < num_states[i]; ++k) {
+            (*seq)[i] = k;
+            search(i + 1);
+        }
+    };
+    search(0);
+    f.DeleteConfiguration(cfg);
+    return best;
+}
+
+int
+check(const char* name,
+      sparsemap::FactorSequence& f,
+      const std::vector<int>& num_states,
+      size_t n_additionals)
+{
+    size_t n_vars = 0;
+    for (auto n : num_states)
+        n_vars += n;
+    auto eta_u = random_vector(n_vars);
+    auto eta_v = random_vector(n_additionals);
+
+    auto cfg = f.CreateConfiguration();
+    double value, check_value;
+    f.Maximize(eta_u, eta_v, cfg, &value);
+    f.Evaluate(eta_u, eta_v, cfg, &check_value);
+    f.DeleteConfiguration(cfg);
+
+    double expected = brute_force(f, num_states, eta_u, eta_v);
+    if (std::abs(value - expected) > 1e-9 ||
+        std::abs(check_value - expected) > 1e-9) {
+        std::cout << name << ": got " << value << " (" << check_value
+                  << "), expected " << expected << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int
+main()
+{
+    int errors = 0;
+
+    for (int length = 1; length <= 5; ++length) {
+        std::vector<int> num_states;
+        for (int i = 0; i < length; ++i)
+            num_states.push_back(1 + (i * 3 + length) % 4);
+
+        sparsemap::FactorSequence seq;
+        seq.Initialize(num_states);
+        errors += check("sequence", seq, num_states, seq.GetNumAdditionals());
+
+        for (int n_states = 1; n_states <= 5; ++n_states) {
+            std::vector<int> same(length, n_states);
+
+            sparsemap::FactorSequenceAdjacent adj;
+            adj.Initialize(length, n_states);
+            errors += check("adjacent", adj, same, adj.GetNumAdditionals());
+
+            for (int range = 1; range <= 3; ++range) {
+                sparsemap::FactorSequenceDistance dist;
+                dist.Initialize(length, n_states, range);
+                errors += check("distance", dist, same,
+                                dist.GetNumAdditionals());
+            }
+        }
+    }
+
+    std::cout << errors << " errors" << std::endl;
+    return errors;
+}
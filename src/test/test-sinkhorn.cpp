@@ -0,0 +1,58 @@
+#include <dynet/dynet.h>
+#include <dynet/expr.h>
+#include <dynet/grad-check.h>
+
+#include <cmath>
+#include <iostream>
+
+#include "layers/sinkhorn.h"
+
+namespace dy = dynet;
+
+// columns sum to one if there are at least as many rows
+int test_marginals(unsigned rows, unsigned cols)
+{
+    dy::ParameterCollection m;
+    auto Xp = m.add_parameters({rows, cols}, 0, "X");
+
+    dy::ComputationGraph cg;
+    auto X = dy::parameter(cg, Xp);
+    auto P = dy::sinkhorn(X, 50, 0.5);
+
+    auto col_sums = dy::as_vector(dy::sum_dim(P, {0u}).value());
+    int errors = 0;
+    for (auto c : col_sums)
+        if (std::abs(c - 1) > 1e-4)
+            ++errors;
+    std::cout << rows << "x" << cols << ": " << dy::sum_dim(P, {0u}).value()
+              << std::endl;
+    return errors;
+}
+
+void test_sinkhorn_grad(unsigned rows, unsigned cols)
+{
+    dy::ParameterCollection m;
+    auto Xp = m.add_parameters({rows, cols}, 0, "X");
+
+    for (size_t i = 0; i < rows; ++i)
+        for (size_t j = 0; j < cols; ++j)
+        {
+            dy::ComputationGraph cg;
+            auto X = dy::parameter(cg, Xp);
+            auto P = dy::sinkhorn(X, 5, 0.5);
+            auto z = dy::pick(dy::pick(P, i), j);
+            cg.backward(z);
+            dy::check_grad(m, z, 1);
+        }
+}
+
+int main(int argc, char** argv)
+{
+    dy::initialize(argc, argv);
+
+    int errors = test_marginals(4, 4) + test_marginals(5, 3);
+    std::cout << "sinkhorn grad" << std::endl;
+    test_sinkhorn_grad(3, 3);
+    test_sinkhorn_grad(4, 2);
+    return errors;
+}
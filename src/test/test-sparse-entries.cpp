@@ -0,0 +1,57 @@
+#include <dynet/dynet.h>
+#include <dynet/expr.h>
+#include <dynet/grad-check.h>
+
+#include <iostream>
+
+#include "layers/sparse-entries.h"
+
+namespace dy = dynet;
+
+// half of the entries of a 4x3 matrix, out of order
+const std::vector<unsigned> indices = { 7, 0, 2, 11, 4, 9 };
+
+void test_gather_entries()
+{
+    dy::ParameterCollection m;
+    auto Xp = m.add_parameters({4, 3}, 0, "X");
+
+    for (size_t k = 0; k < indices.size(); ++k)
+    {
+        dy::ComputationGraph cg;
+        auto X = dy::parameter(cg, Xp);
+        auto u = dy::gather_entries(X, indices);
+        auto z = dy::pick(u, k);
+        cg.backward(z);
+        dy::check_grad(m, z, 1);
+    }
+}
+
+void test_scatter_entries()
+{
+    dy::ParameterCollection m;
+    unsigned nnz = indices.size();
+    auto up = m.add_parameters({nnz}, 0, "u");
+
+    for (size_t i = 0; i < 4; ++i)
+        for (size_t j = 0; j < 3; ++j)
+        {
+            dy::ComputationGraph cg;
+            auto u = dy::parameter(cg, up);
+            auto X = dy::scatter_entries(u, indices, {4, 3});
+            auto z = dy::pick(dy::pick(X, i), j);
+            cg.backward(z);
+            dy::check_grad(m, z, 1);
+        }
+}
+
+
+int main(int argc, char** argv)
+{
+    dy::initialize(argc, argv);
+
+    std::cout << "gather entries" << std::endl;
+    test_gather_entries();
+    std::cout << "scatter entries" << std::endl;
+    test_scatter_entries();
+}
@@ -0,0 +1,141 @@
+#include <dynet/dynet.h>
+#include <dynet/expr.h>
+#include <dynet/grad-check.h>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "layers/tree-aggregate.h"
+
+namespace dy = dynet;
+
+
+dy::Expression
+dense_adj(dy::ComputationGraph& cg, const std::vector<unsigned>& heads)
+{
+    unsigned n = heads.size();
+    std::vector<float> data((1 + n) * (1 + n), 0.0f);
+    for (size_t i = 0; i < n; ++i)
+        data[(1 + n) * (1 + i) + heads[i]] = 1;
+    return dy::input(cg, { 1 + n, 1 + n }, data);
+}
+
+float
+max_abs_diff(const dy::Expression& a, const dy::Expression& b)
+{
+    auto va = dy::as_vector(a.value());
+    auto vb = dy::as_vector(b.value());
+    float res = 0;
+    for (size_t k = 0; k < va.size(); ++k)
+        res = std::max(res, std::abs(va[k] - vb[k]));
+    return res;
+}
+
+int
+check_close(const char* name, const dy::Expression& a, const dy::Expression& b)
+{
+    float diff = max_abs_diff(a, b);
+    std::cout << name << " " << diff << std::endl;
+    return diff > 1e-4 ? 1 : 0;
+}
+
+int test_tree_aggregate(const std::vector<unsigned>& heads, unsigned dim)
+{
+    int errors = 0;
+    dy::ParameterCollection m;
+    unsigned n = heads.size();
+    auto X_p = m.add_parameters({ dim, 1 + n }, 0, "X");
+
+    {
+        dy::ComputationGraph cg;
+        auto X = dy::parameter(cg, X_p);
+        auto G = dense_adj(cg, heads);
+
+        auto parents = dy::tree_parents(X, heads);
+        auto children = dy::tree_children(X, heads);
+        cg.forward(parents + children);
+
+        errors += check_close("parents vs dense", parents, X * G);
+        errors += check_close("children vs dense", children,
+                              X * dy::transpose(G));
+    }
+
+    for (size_t i = 0; i < dim; ++i)
+        for (size_t j = 0; j <= n; ++j)
+        {
+            dy::ComputationGraph cg;
+            auto X = dy::parameter(cg, X_p);
+            auto Y = dy::tree_parents(X, heads)
+                   + 2 * dy::tree_children(X, heads);
+            auto z = dy::pick(dy::pick(Y, j, 1), i);
+            cg.backward(z);
+            if (!dy::check_grad(m, z, 1))
+                ++errors;
+        }
+    return errors;
+}
+
+int test_tree_mixture_aggregate(
+  const std::vector<std::vector<unsigned>>& trees, unsigned dim)
+{
+    int errors = 0;
+    dy::ParameterCollection m;
+    unsigned n = trees[0].size();
+    unsigned k = trees.size();
+    auto X_p = m.add_parameters({ dim, 1 + n }, 0, "X");
+    auto w_p = m.add_parameters({ k }, 0, "w");
+
+    {
+        dy::ComputationGraph cg;
+        auto X = dy::parameter(cg, X_p);
+        auto w = dy::parameter(cg, w_p);
+
+        auto parents = dy::tree_parents(X, trees, w);
+        auto children = dy::tree_children(X, trees, w);
+        cg.forward(parents + children);
+
+        auto w_val = dy::as_vector(w.value());
+        auto G = w_val[0] * dense_adj(cg, trees[0]);
+        for (unsigned t = 1; t < k; ++t)
+            G = G + w_val[t] * dense_adj(cg, trees[t]);
+        errors += check_close("mixture parents vs dense", parents, X * G);
+        errors += check_close("mixture children vs dense", children,
+                              X * dy::transpose(G));
+    }
+
+    for (size_t i = 0; i < dim; ++i)
+        for (size_t j = 0; j <= n; ++j)
+        {
+            dy::ComputationGraph cg;
+            auto X = dy::parameter(cg, X_p);
+            auto w = dy::parameter(cg, w_p);
+            auto Y = dy::tree_parents(X, trees, w)
+                   + 2 * dy::tree_children(X, trees, w);
+            auto z = dy::pick(dy::pick(Y, j, 1), i);
+            cg.backward(z);
+            if (!dy::check_grad(m, z, 1))
+                ++errors;
+        }
+    return errors;
+}
+
+
+int main(int argc, char** argv)
+{
+    dy::initialize(argc, argv);
+
+    int errors = 0;
+    std::cout << "flat" << std::endl;
+    errors += test_tree_aggregate({ 0, 0, 0, 0 }, 3);
+    std::cout << "left to right" << std::endl;
+    errors += test_tree_aggregate({ 2, 3, 4, 5, 0 }, 3);
+    std::cout << "branching" << std::endl;
+    errors += test_tree_aggregate({ 2, 0, 2, 3, 3, 2 }, 3);
+    std::cout << "mixture" << std::endl;
+    errors += test_tree_mixture_aggregate({ { 2, 0, 2, 3, 3, 2 },
+                                            { 0, 0, 0, 0, 0, 0 },
+                                            { 2, 3, 4, 5, 6, 0 } }, 3);
+    std::cout << errors << " errors" << std::endl;
+    return errors;
+}
@@ -0,0 +1,83 @@
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "factors/FactorTreeAlignment.h"
+
+/* check the tree DP of FactorTreeAlignment against brute force */
+
+std::mt19937 rng(42);
+
+// one-based heads of a random forest over n words, entry 0 for the root
+std::vector<int>
+random_heads(int n)
+{
+    std::vector<int> heads(n + 1, 0);
+    for (int i = 1; i < n; ++i)
+        heads[1 + i] = std::uniform_int_distribution<int>(0, i)(rng);
+    return heads;
+}
+
+int
+check(int prem_sz, int hypo_sz, bool higher_order)
+{
+    auto prem_heads = random_heads(prem_sz);
+    auto hypo_heads = random_heads(hypo_sz);
+
+    sparsemap::FactorTreeAlignment f;
+    f.Initialize(prem_heads, hypo_heads, higher_order);
+
+    std::normal_distribution<double> normal;
+    std::vector<double> eta_u(prem_sz * hypo_sz);
+    std::vector<double> eta_v(f.GetNumAdditionals());
+    for (auto& u : eta_u)
+        u = normal(rng);
+    for (auto& v : eta_v)
+        v = 2 * normal(rng);
+
+    auto cfg = f.CreateConfiguration();
+    double value, check_value;
+    f.Maximize(eta_u, eta_v, cfg, &value);
+    f.Evaluate(eta_u, eta_v, cfg, &check_value);
+
+    // all prem_sz ** hypo_sz alignments
+    auto a = static_cast<std::vector<int>*>(cfg);
+    double best = -std::numeric_limits<double>::infinity();
+    std::function<void(int)> search = [&](int j) {
+        if (j == hypo_sz) {
+            double val;
+            f.Evaluate(eta_u, eta_v, cfg, &val);
+            best = std::max(best, val);
+            return;
+        }
+        for (int i = 0; i < prem_sz; ++i) {
+            (*a)[j] = i;
+            search(j + 1);
+        }
+    };
+    search(0);
+    f.DeleteConfiguration(cfg);
+
+    if (std::abs(value - best) > 1e-9 || std::abs(check_value - best) > 1e-9) {
+        std::cout << prem_sz << "x" << hypo_sz << ": got " << value << " ("
+                  << check_value << "), expected " << best << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int
+main()
+{
+    int errors = 0;
+    for (int rep = 0; rep < 10; ++rep)
+        for (int prem_sz = 1; prem_sz <= 5; ++prem_sz)
+            for (int hypo_sz = 1; hypo_sz <= 5; ++hypo_sz) {
+                errors += check(prem_sz, hypo_sz, false);
+                errors += check(prem_sz, hypo_sz, true);
+            }
+    std::cout << errors << " errors" << std::endl;
+    return errors;
+}
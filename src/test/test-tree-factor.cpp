@@ -0,0 +1,189 @@
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "factors/TreeFactor.h"
+
+/* check every TreeFactor decoder against brute force over all trees */
+
+std::mt19937 rng(42);
+
+bool
+is_tree(const std::vector<int>& heads)
+{
+    int n = heads.size();
+    for (int m = 1; m < n; ++m) {
+        int h = m;
+        for (int steps = 0; h != 0; ++steps) {
+            if (steps >= n)
+                return false;
+            h = heads[h];
+        }
+    }
+    return true;
+}
+
+// no arc crosses another, and the root arc crosses nothing
+bool
+is_projective(const std::vector<int>& heads)
+{
+    int n = heads.size();
+    for (int m = 1; m < n; ++m) {
+        int lo = std::min(m, heads[m]), hi = std::max(m, heads[m]);
+        for (int k = lo + 1; k < hi; ++k) {
+            int h = k;
+            while (h != 0 && h != heads[m])
+                h = heads[h];
+            if (h != heads[m])
+                return false;
+        }
+    }
+    return true;
+}
+
+int
+max_modifiers(const std::vector<int>& heads, bool count_root)
+{
+    std::vector<int> count(heads.size(), 0);
+    for (size_t m = 1; m < heads.size(); ++m)
+        count[heads[m]] += 1;
+    int most = 0;
+    for (size_t h = count_root ? 0 : 1; h < heads.size(); ++h)
+        most = std::max(most, count[h]);
+    return most;
+}
+
+// best score of a tree accepted by `valid`
+double
+brute_force(int length,
+            const AD3::TreeSkeleton& skeleton,
+            const std::vector<double>& scores,
+            std::function<bool(const std::vector<int>&)> valid)
+{
+    std::vector<int> heads(length, -1);
+    double best = -std::numeric_limits<double>::infinity();
+
+    std::function<void(int)> search = [&](int m) {
+        if (m == length) {
+            if (!is_tree(heads) || !valid(heads))
+                return;
+            double val = 0;
+            for (int k = 1; k < length; ++k)
+                val += scores[skeleton.index_arcs[heads[k]][k]];
+            best = std::max(best, val);
+            return;
+        }
+        for (int h = 0; h < length; ++h) {
+            if (h == m)
+                continue;
+            heads[m] = h;
+            search(m + 1);
+        }
+    };
+    search(1);
+    return best;
+}
+
+template <class Decoder>
+int
+check(const char* name,
+      const std::shared_ptr<const AD3::TreeSkeleton>& skeleton,
+      const std::vector<double>& scores,
+      const Decoder& decoder,
+      std::function<bool(const std::vector<int>&)> valid)
+{
+    AD3::TreeFactor<Decoder> f;
+    f.Initialize(skeleton, decoder);
+    auto cfg = f.CreateConfiguration();
+    double value, check_value;
+    f.Maximize(scores, {}, cfg, &value);
+    f.Evaluate(scores, {}, cfg, &check_value);
+    auto heads = *static_cast<std::vector<int>*>(cfg);
+    f.DeleteConfiguration(cfg);
+
+    double expected = brute_force(skeleton->length, *skeleton, scores, valid);
+    if (std::abs(value - expected) > 1e-9
+        || std::abs(check_value - expected) > 1e-9 || !is_tree(heads)
+        || !valid(heads)) {
+        std::cout << name << " (" << skeleton->length << "): got " << value
+                  << " (" << check_value << "), expected " << expected
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int
+main()
+{
+    std::normal_distribution<double> normal;
+    int errors = 0;
+
+    for (int length = 2; length <= 6; ++length) {
+        auto skeleton = std::make_shared<const AD3::TreeSkeleton>(length);
+        for (int rep = 0; rep < 20; ++rep) {
+            std::vector<double> scores(skeleton->arcs.size());
+            for (auto& s : scores)
+                s = normal(rng);
+
+            auto any = [](const std::vector<int>&) { return true; };
+            auto single_root = [](const std::vector<int>& heads) {
+                int roots = 0;
+                for (size_t m = 1; m < heads.size(); ++m)
+                    roots += heads[m] == 0;
+                return roots == 1;
+            };
+
+            errors += check(
+              "cle-dense", skeleton, scores,
+              AD3::ChuLiuEdmondsDenseDecoder{}, any);
+            errors += check(
+              "cle-sparse", skeleton, scores,
+              AD3::ChuLiuEdmondsSparseDecoder{}, any);
+            errors += check(
+              "eisner", skeleton, scores, AD3::EisnerDecoder{},
+              [&](const std::vector<int>& heads) {
+                  return single_root(heads) && is_projective(heads);
+              });
+            for (int valency = 1; valency <= 2; ++valency) {
+                errors += check(
+                  "eisner-valency", skeleton, scores,
+                  AD3::EisnerValencyDecoder{ valency },
+                  [&](const std::vector<int>& heads) {
+                      return single_root(heads) && is_projective(heads)
+                             && max_modifiers(heads, false) <= valency;
+                  });
+            }
+        }
+    }
+
+    // a pruned arc set: sparse CLE only sees the arcs it is given
+    int length = 7;
+    std::vector<std::tuple<int, int>> arcs;
+    for (int m = 1; m < length; ++m)
+        for (int h = 0; h < length; ++h)
+            if (h != m && (h == 0 || std::abs(h - m) <= 2))
+                arcs.push_back(std::make_tuple(h, m));
+    auto pruned = std::make_shared<const AD3::TreeSkeleton>(length, arcs);
+    for (int rep = 0; rep < 20; ++rep) {
+        std::vector<double> scores(arcs.size());
+        for (auto& s : scores)
+            s = normal(rng);
+        auto in_set = [&](const std::vector<int>& heads) {
+            for (int m = 1; m < length; ++m)
+                if (pruned->index_arcs[heads[m]][m] < 0)
+                    return false;
+            return true;
+        };
+        errors += check("cle-sparse pruned", pruned, scores,
+                        AD3::ChuLiuEdmondsSparseDecoder{}, in_set);
+        errors += check("cle-dense pruned", pruned, scores,
+                        AD3::ChuLiuEdmondsDenseDecoder{}, in_set);
+    }
+
+    std::cout << errors << " errors" << std::endl;
+    return errors;
+}